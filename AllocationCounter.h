@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "TextAnalyzer.h"
+
+// Counts every global operator new, i.e. every heap allocation of the standard containers.
+// It replaces the global operators, so only one translation unit of a program may include it.
+// Atomic because the pipelines allocate from several threads at once.
+inline atomic<size_t> allocationCount{0};
+
+// GCC pairs the free() below with the replaced operator new it inlines and warns about a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if(void* pointer = malloc(size == 0 ? 1 : size)){
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// pmr::new_delete_resource allocates through the aligned forms
+void* operator new(size_t size, align_val_t alignment) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if(void* pointer = aligned_alloc(size_t(alignment), (max<size_t>(size, 1) + size_t(alignment) - 1) / size_t(alignment) * size_t(alignment))){
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer, align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t, align_val_t) noexcept {
+    free(pointer);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
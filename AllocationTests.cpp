@@ -0,0 +1,64 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include "TextAnalyzer.h"
+#include "Lexicon.h"
+#include "CompiledLexicon.h"
+#include "GeneratedMatcher.h"
+#include "AllocationCounter.h"
+
+// Once the first chapter has sized the chapter arena and the thread's buffers, no chapter of the
+// book may allocate on the heap any more.
+auto heap_allocations_after_first_chapter = [](const auto& filterPeaceTerms, const auto& filterWarTerms) -> vector<size_t> {
+    static const string book = flatten_lines(read_text("./data/book.txt").value());
+    const auto chapters = split_book_into_chapter_views(book);
+
+    vector<size_t> allocations;
+    allocations.reserve(chapters.size());
+    for (const string_view chapter : chapters) {
+        size_t before = allocationCount;
+        process_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+        allocations.push_back(allocationCount - before);
+    }
+    allocations.erase(allocations.begin());
+    return allocations;
+};
+
+auto chapters_that_allocated = [](const vector<size_t>& allocations) {
+    return count_if(allocations.begin(), allocations.end(), [](size_t count) { return count > 0; });
+};
+
+TEST_CASE("Term lists do not allocate after the first chapter") {
+    vector<string> peaceTerms = read_terms("./data/peace_terms.txt").value();
+    vector<string> warTerms = read_terms("./data/war_terms.txt").value();
+    auto allocations = heap_allocations_after_first_chapter(bind(filter_words_into, placeholders::_1, cref(peaceTerms), placeholders::_2),
+                                                            bind(filter_words_into, placeholders::_1, cref(warTerms), placeholders::_2));
+
+    CHECK(allocations.size() == 364);
+    CHECK(chapters_that_allocated(allocations) == 0);
+}
+
+TEST_CASE("Fuzzy matching does not allocate after the first chapter") {
+    auto peaceIndex = build_deletion_index(read_terms("./data/peace_terms.txt").value());
+    auto warIndex = build_deletion_index(read_terms("./data/war_terms.txt").value());
+    auto allocations = heap_allocations_after_first_chapter(bind(fuzzy_filter_words_into, placeholders::_1, cref(peaceIndex), placeholders::_2),
+                                                            bind(fuzzy_filter_words_into, placeholders::_1, cref(warIndex), placeholders::_2));
+
+    CHECK(allocations.size() == 364);
+    CHECK(chapters_that_allocated(allocations) == 0);
+}
+
+TEST_CASE("Compiled and generated lexicons do not allocate after the first chapter") {
+    auto blob = compile_lexicon(read_terms("./data/peace_terms.txt").value(), read_terms("./data/war_terms.txt").value());
+    auto lexicon = view_compiled_lexicon(blob.data(), blob.size(), nullptr);
+    REQUIRE(lexicon.has_value());
+    auto compiled = heap_allocations_after_first_chapter(bind(compiled_filter_words_into, placeholders::_1, cref(lexicon.value()), Relation::PEACE, placeholders::_2),
+                                                         bind(compiled_filter_words_into, placeholders::_1, cref(lexicon.value()), Relation::WAR, placeholders::_2));
+    CHECK(compiled.size() == 364);
+    CHECK(chapters_that_allocated(compiled) == 0);
+
+    auto generated = heap_allocations_after_first_chapter(bind(generated_filter_words_into, placeholders::_1, Relation::PEACE, placeholders::_2),
+                                                          bind(generated_filter_words_into, placeholders::_1, Relation::WAR, placeholders::_2));
+    CHECK(generated.size() == 364);
+    CHECK(chapters_that_allocated(generated) == 0);
+}
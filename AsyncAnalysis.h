@@ -0,0 +1,456 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Pipeline.h"
+
+// Coroutines for analyzing books inside an event loop. A book is read with non-blocking reads, its
+// chapters are cut out as blocks arrive and every chapter is summarized as a task that may run on any
+// thread of the loop, so many analyses share a few threads and none of them blocks the others.
+// Pipes and sockets are waited for with epoll; a regular file is always readable, so its reader
+// yields to the loop after every block instead.
+#pragma region event loop
+class EventLoop {
+public:
+    EventLoop() : epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    ~EventLoop() {
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    // Resumes the coroutine on one of the threads running the loop
+    void post(const coroutine_handle<> coroutine) {
+        {
+            lock_guard<mutex> lock(guard);
+            ready.push_back(coroutine);
+        }
+        wake();
+    }
+
+    void wake() {
+        const uint64_t one = 1;
+        [[maybe_unused]] auto written = write(wakeFd, &one, sizeof(one));
+    }
+
+    // co_await loop.schedule() continues on the loop after everything that is already waiting
+    auto schedule() {
+        struct Awaiter {
+            EventLoop& loop;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(const coroutine_handle<> coroutine) { loop.post(coroutine); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // co_await loop.readable(fd) continues once fd has data or is closed; false if fd cannot be waited for
+    auto readable(const int fd) {
+        struct Awaiter {
+            EventLoop& loop;
+            int fd;
+            bool failed = false;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(const coroutine_handle<> coroutine) {
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                event.data.ptr = coroutine.address();
+                if (epoll_ctl(loop.epollFd, EPOLL_CTL_MOD, fd, &event) != 0 && epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+                    failed = true;
+                    return false;
+                }
+                // another thread may resume the coroutine from here on
+                return true;
+            }
+            bool await_resume() const noexcept { return !failed; }
+        };
+        return Awaiter{*this, fd};
+    }
+
+    // Before fd is closed
+    void forget(const int fd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    // Runs coroutines on the calling thread and threadCount - 1 more until done() is true
+    void run_until(const function<bool()>& done, const size_t threadCount = 1) {
+        auto work = [this, &done]() {
+            while (!done()) {
+                if (!resume_one()) {
+                    poll(100);
+                }
+            }
+            // the other threads may be waiting in epoll_wait
+            wake();
+        };
+        vector<thread> helpers;
+        for (size_t i = 1; i < threadCount; i++) {
+            helpers.emplace_back(work);
+        }
+        work();
+        for (thread& helper : helpers) {
+            helper.join();
+        }
+    }
+
+private:
+    bool resume_one() {
+        coroutine_handle<> coroutine;
+        {
+            lock_guard<mutex> lock(guard);
+            if (ready.empty()) {
+                return false;
+            }
+            coroutine = ready.front();
+            ready.pop_front();
+        }
+        coroutine.resume();
+        return true;
+    }
+
+    void poll(const int timeoutMilliseconds) {
+        epoll_event events[64];
+        const int count = epoll_wait(epollFd, events, 64, timeoutMilliseconds);
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                uint64_t wakeups;
+                [[maybe_unused]] auto drained = read(wakeFd, &wakeups, sizeof(wakeups));
+            } else {
+                coroutine_handle<>::from_address(events[i].data.ptr).resume();
+            }
+        }
+    }
+
+    int epollFd;
+    int wakeFd;
+    mutex guard;
+    deque<coroutine_handle<>> ready;
+};
+#pragma endregion event loop
+
+#pragma region coroutine types
+// Starts when it is awaited and continues the awaiting coroutine when it is done
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        optional<T> value;
+        exception_ptr exception;
+        coroutine_handle<> continuation = noop_coroutine();
+
+        Task get_return_object() {
+            return Task(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        auto final_suspend() noexcept {
+            struct Continue {
+                bool await_ready() const noexcept { return false; }
+                coroutine_handle<> await_suspend(const coroutine_handle<promise_type> done) noexcept { return done.promise().continuation; }
+                void await_resume() const noexcept {}
+            };
+            return Continue{};
+        }
+        void return_value(T result) {
+            value = std::move(result);
+        }
+        void unhandled_exception() {
+            exception = current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : coroutine(exchange(other.coroutine, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    coroutine_handle<> await_suspend(const coroutine_handle<> awaiting) noexcept {
+        coroutine.promise().continuation = awaiting;
+        return coroutine;
+    }
+    T await_resume() {
+        if (coroutine.promise().exception) {
+            rethrow_exception(coroutine.promise().exception);
+        }
+        return std::move(coroutine.promise().value.value());
+    }
+
+private:
+    explicit Task(const coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+    coroutine_handle<promise_type> coroutine;
+};
+
+// co_await generator.next() runs the generator to its next co_yield; nullopt once it has returned
+template <typename T>
+class AsyncGenerator {
+public:
+    struct promise_type {
+        optional<T> current;
+        exception_ptr exception;
+        coroutine_handle<> consumer;
+
+        struct ToConsumer {
+            bool await_ready() const noexcept { return false; }
+            coroutine_handle<> await_suspend(const coroutine_handle<promise_type> producer) noexcept { return producer.promise().consumer; }
+            void await_resume() const noexcept {}
+        };
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        ToConsumer final_suspend() noexcept {
+            return {};
+        }
+        ToConsumer yield_value(T value) {
+            current = std::move(value);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            exception = current_exception();
+        }
+    };
+
+    AsyncGenerator(AsyncGenerator&& other) noexcept : coroutine(exchange(other.coroutine, {})) {}
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+
+    ~AsyncGenerator() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    auto next() {
+        struct Awaiter {
+            coroutine_handle<promise_type> producer;
+
+            bool await_ready() const noexcept { return producer.done(); }
+            coroutine_handle<> await_suspend(const coroutine_handle<> consumer) noexcept {
+                producer.promise().consumer = consumer;
+                producer.promise().current.reset();
+                return producer;
+            }
+            optional<T> await_resume() {
+                if (producer.promise().exception) {
+                    rethrow_exception(producer.promise().exception);
+                }
+                return std::move(producer.promise().current);
+            }
+        };
+        return Awaiter{coroutine};
+    }
+
+private:
+    explicit AsyncGenerator(const coroutine_handle<promise_type> coroutine) : coroutine(coroutine) {}
+
+    coroutine_handle<promise_type> coroutine;
+};
+
+// Runs on its own from the start and frees itself at the end
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept {
+            return {};
+        }
+        suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            terminate();
+        }
+    };
+};
+
+template <typename T>
+DetachedTask complete_into(Task<T> task, optional<T>& result, atomic<size_t>& remaining, const function<void()> last) {
+    result = co_await std::move(task);
+    if (remaining.fetch_sub(1, memory_order_acq_rel) == 1) {
+        last();
+    }
+}
+
+// Starts every task at once; done when all are, with the results in the order of the tasks
+template <typename T>
+Task<vector<T>> when_all(vector<Task<T>> tasks) {
+    vector<optional<T>> results(tasks.size());
+    // one more than there are tasks, so none can finish the wait before it has started
+    atomic<size_t> remaining{tasks.size() + 1};
+
+    struct StartAll {
+        vector<Task<T>>& tasks;
+        vector<optional<T>>& results;
+        atomic<size_t>& remaining;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(const coroutine_handle<> waiting) {
+            for (size_t i = 0; i < tasks.size(); i++) {
+                complete_into(std::move(tasks[i]), results[i], remaining, [waiting]() { waiting.resume(); });
+            }
+            return remaining.fetch_sub(1, memory_order_acq_rel) != 1;
+        }
+        void await_resume() const noexcept {}
+    };
+    co_await StartAll{tasks, results, remaining};
+
+    vector<T> values;
+    values.reserve(results.size());
+    for (optional<T>& result : results) {
+        values.push_back(std::move(result.value()));
+    }
+    co_return values;
+}
+
+// The blocking way in: runs the loop on the calling thread and threadCount - 1 more until task is done
+template <typename T>
+T sync_wait(EventLoop& loop, Task<T> task, const size_t threadCount = 1) {
+    optional<T> result;
+    atomic<size_t> remaining{1};
+    complete_into(std::move(task), result, remaining, [&loop]() { loop.wake(); });
+    loop.run_until([&remaining]() { return remaining.load(memory_order_acquire) == 0; }, threadCount);
+    return std::move(result.value());
+}
+#pragma endregion coroutine types
+
+#pragma region async analysis
+// Closes the file when the coroutine that reads it ends, also when it is destroyed before
+struct AsyncFile {
+    EventLoop& loop;
+    int fd;
+
+    ~AsyncFile() {
+        if (fd >= 0) {
+            loop.forget(fd);
+            close(fd);
+        }
+    }
+};
+
+auto open_async = [](const string& path) -> optional<int> {
+    const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return nullopt;
+    }
+    return fd;
+};
+
+// A chapter is summarized on whichever thread of the loop gets to it first
+template <typename PeaceFilter, typename WarFilter>
+Task<ChapterResult> summarize_chapter_async(EventLoop& loop, const int number, string chapter, PeaceFilter filterPeaceTerms, WarFilter filterWarTerms) {
+    co_await loop.schedule();
+    co_return ChapterResult{number, summarize_chapter(chapter)(filterPeaceTerms, filterWarTerms)};
+}
+
+// The chapters of the book read from fd, which the generator closes, in order and as soon as the
+// heading after each has been read; the same chapters as the batch path gets from the whole file.
+// If fd cannot be read to its end, next() throws a system_error instead of ending with what was read.
+template <typename PeaceFilter, typename WarFilter>
+AsyncGenerator<ChapterResult> analyze_book_async(EventLoop& loop, const int fd, PeaceFilter filterPeaceTerms, WarFilter filterWarTerms) {
+    AsyncFile file{loop, fd};
+    struct stat info{};
+    const bool regularFile = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+
+    ChapterBoundaryDetector detector;
+    vector<string> found;
+    auto collect = [&found](string chapter) { found.push_back(std::move(chapter)); };
+    int number = 0;
+    string block(pipelineBlockSize, '\0');
+    bool reading = true;
+    while (reading) {
+        const ssize_t count = read(fd, block.data(), block.size());
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!co_await loop.readable(fd)) {
+                throw system_error(errno, generic_category(), "waiting for the book to be readable");
+            }
+            continue;
+        }
+        if (count < 0) {
+            throw system_error(errno, generic_category(), "reading the book");
+        }
+        if (count == 0) {
+            detector.finish(collect);
+            reading = false;
+        } else {
+            detector.feed(string_view(block.data(), size_t(count)), collect);
+        }
+
+        for (string& chapter : found) {
+            co_yield co_await summarize_chapter_async(loop, ++number, std::move(chapter), filterPeaceTerms, filterWarTerms);
+        }
+        found.clear();
+        if (regularFile && reading) {
+            co_await loop.schedule();
+        }
+    }
+}
+
+// Relations of every chapter of the book at path; nullopt if it cannot be opened or read
+template <typename PeaceFilter, typename WarFilter>
+Task<optional<map<int, Relation>>> analyze_book(EventLoop& loop, const string path, PeaceFilter filterPeaceTerms, WarFilter filterWarTerms) {
+    const auto fd = open_async(path);
+    if (!fd.has_value()) {
+        co_return nullopt;
+    }
+    auto chapters = analyze_book_async(loop, fd.value(), filterPeaceTerms, filterWarTerms);
+    map<int, Relation> relations;
+    try {
+        while (auto result = co_await chapters.next()) {
+            relations.emplace_hint(relations.end(), result->number, result->summary.relation);
+        }
+    } catch (const system_error&) {
+        co_return nullopt;
+    }
+    co_return relations;
+}
+
+// The blocking path on top of the coroutines, with a loop of its own
+auto process_book = [](const string& bookPath) {
+    return [&bookPath](const auto& filterPeaceTerms, const auto& filterWarTerms) -> optional<map<int, Relation>> {
+        EventLoop loop;
+        return sync_wait(loop, analyze_book(loop, bookPath, filterPeaceTerms, filterWarTerms));
+    };
+};
+#pragma endregion async analysis
@@ -0,0 +1,556 @@
+#include <chrono>
+#include <regex>
+#include <unordered_map>
+
+#include "TextAnalyzer.h"
+#include "Lexicon.h"
+#include "CompiledLexicon.h"
+#include "SectionPattern.h"
+#include "ChapterSelection.h"
+#include "PositionList.h"
+#include "ThreadPool.h"
+#include "WorkStealing.h"
+#include "Pipeline.h"
+#include "ParallelAlgorithms.h"
+#include "CorpusStatistics.h"
+#include "Placement.h"
+#include "MultiProcess.h"
+#include "GeneratedMatcher.h"
+#include "AllocationCounter.h"
+
+auto measure = [](const string& name, const auto& action) {
+    auto start = chrono::steady_clock::now();
+    auto result = action();
+    auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << name << ": " << elapsed << " ms" << endl;
+    return result;
+};
+
+auto benchmark_fuzzy_matching = [](const vector<Word>& words, const vector<string>& terms) {
+    cout << "== exact vs fuzzy matching (" << words.size() << " tokens, " << terms.size() << " terms) ==" << endl;
+
+    auto exactHits = measure("filter_words", [&]() { return filter_words(words, terms); });
+    auto index = measure("build_deletion_index", [&]() { return build_deletion_index(terms); });
+    auto fuzzyHits = measure("fuzzy_filter_words", [&]() { return fuzzy_filter_words(words, index); });
+
+    cout << "exact hits: " << exactHits.size() << ", fuzzy hits: " << fuzzyHits.size() << endl;
+};
+
+// Text lexicons are parsed and indexed on every start, the compiled one is only mapped
+auto benchmark_lexicon_loading = [](const size_t termCount) {
+    cout << "== lexicon loading (" << termCount << " terms) ==" << endl;
+
+    vector<string> terms(termCount);
+    generate(terms.begin(), terms.end(), [n = 0]() mutable { return "term" + to_string(n++); });
+    const string textPath = "./out/bench_terms.txt";
+    const string compiledPath = "./out/bench_lexicon.bin";
+    {
+        ofstream text(textPath);
+        for_each(terms.begin(), terms.end(), [&text](const string& term) { text << term << '\n'; });
+    }
+    write_compiled_lexicon(compiledPath, compile_lexicon(terms, {}));
+
+    measure("read_terms + build_deletion_index", [&]() { return build_deletion_index(read_terms(textPath).value()).terms.size(); });
+    measure("load_compiled_lexicon", [&]() { return load_compiled_lexicon(compiledPath)->header().termCount; });
+};
+
+auto benchmark_compiled_matching = [](const vector<Word>& words, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== vector vs compiled vs generated lexicon matching ==" << endl;
+
+    auto blob = compile_lexicon(peaceTerms, warTerms);
+    auto lexicon = view_compiled_lexicon(blob.data(), blob.size(), nullptr).value();
+    measure("filter_words (war)", [&]() { return filter_words(words, warTerms).size(); });
+    measure("compiled_filter_words (war)", [&]() { return compiled_filter_words(words, lexicon, Relation::WAR).size(); });
+    measure("generated_filter_words (war)", [&]() { return generated_filter_words(words, Relation::WAR).size(); });
+    measure("filter_words (peace)", [&]() { return filter_words(words, peaceTerms).size(); });
+    measure("compiled_filter_words (peace)", [&]() { return compiled_filter_words(words, lexicon, Relation::PEACE).size(); });
+    measure("generated_filter_words (peace)", [&]() { return generated_filter_words(words, Relation::PEACE).size(); });
+};
+
+// The regex split the scanner replaced, kept as the baseline
+auto split_book_into_chapters_regex = [](const string& book) -> vector<string> {
+    regex chapter_regex(R"(CHAPTER \d+)");
+    sregex_token_iterator chapters_begin(book.begin(), book.end(), chapter_regex, -1);
+    sregex_token_iterator chapters_end;
+    vector<string> chapters(chapters_begin, chapters_end);
+    chapters.erase(chapters.begin());
+    return chapters;
+};
+
+auto benchmark_chapter_splitting = [](const string& book) {
+    cout << "== chapter splitting (" << book.size() << " bytes) ==" << endl;
+
+    auto byRegex = measure("split_book_into_chapters_regex", [&]() { return split_book_into_chapters_regex(book); });
+    auto ranges = measure("find_chapter_ranges", [&]() { return find_chapter_ranges(book); });
+    auto views = measure("split_book_into_chapter_views", [&]() { return split_book_into_chapter_views(book); });
+    auto dfa = measure("compile_section_patterns", [&]() {
+        return compile_section_patterns({parse_section_pattern("CHAPTER {digits}").value()});
+    });
+    auto sections = measure("find_section_ranges", [&]() { return find_section_ranges(book, dfa); });
+    auto multiDfa = compile_section_patterns({parse_section_pattern("CHAPTER {digits}").value(),
+                                              parse_section_pattern("Chapter {roman}").value(),
+                                              parse_section_pattern("Part {digits}").value()});
+    measure("find_section_ranges (3 patterns)", [&]() { return find_section_ranges(book, multiDfa); });
+
+    cout << "chapters: " << byRegex.size() << " / " << ranges.size() << " / " << views.size()
+         << (equal(byRegex.begin(), byRegex.end(), views.begin(), views.end()) ? ", identical" : ", DIFFERENT")
+         << (sections == ranges ? ", DFA identical" : ", DFA DIFFERENT") << endl;
+};
+
+auto benchmark_boilerplate_stripping = [](const string& text) {
+    cout << "== Gutenberg boilerplate ==" << endl;
+
+    auto body = measure("find_gutenberg_body", [&]() { return find_gutenberg_body(text); });
+    cout << "body: " << body.end - body.begin << " of " << text.size() << " bytes, "
+         << text.size() - body.end << " bytes of license skipped" << endl;
+};
+
+auto benchmark_chapter_selection = [](const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== single chapter selection ==" << endl;
+
+    const string bookPath = "./data/book.txt";
+    const string sidecarPath = "./out/bench_book.chapters";
+    filesystem::remove(sidecarPath);
+    auto filterPeaceTerms = bind(filter_words, _1, cref(peaceTerms));
+    auto filterWarTerms = bind(filter_words, _1, cref(warTerms));
+
+    measure("chapter 100 without sidecar", [&]() {
+        return process_chapter_selection(bookPath, load_chapter_ranges(bookPath, sidecarPath).value(), {100, 100})(filterPeaceTerms, filterWarTerms);
+    });
+    measure("chapter 100 with sidecar", [&]() {
+        return process_chapter_selection(bookPath, load_chapter_ranges(bookPath, sidecarPath).value(), {100, 100})(filterPeaceTerms, filterWarTerms);
+    });
+};
+
+auto benchmark_chapter_arena = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== per-chapter working memory ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+
+    auto run = [&](const string& name, const auto& summarize) {
+        size_t allocationsBefore = allocationCount;
+        measure(name, [&]() {
+            return accumulate(chapters.begin(), chapters.end(), 0, [&](int warChapters, const string_view chapter) {
+                return warChapters + (summarize(chapter).relation == Relation::WAR ? 1 : 0);
+            });
+        });
+        cout << "  heap allocations: " << allocationCount - allocationsBefore << endl;
+    };
+
+    run("heap (new_delete_resource)", [&](const string_view chapter) {
+        return summarize_chapter_with(chapter, pmr::new_delete_resource())(filterPeaceTerms, filterWarTerms);
+    });
+    run("chapter arena", [&](const string_view chapter) {
+        return summarize_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+    });
+    run("chapter arena, second pass", [&](const string_view chapter) {
+        return summarize_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+    });
+};
+
+auto benchmark_token_layout = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== token layout ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+
+    // The chapter pipeline as it was over a vector of Word
+    auto summarize_words = [&](const string_view chapter, pmr::memory_resource* memory) {
+        pmr::vector<Word> words(memory);
+        tokenize_into(chapter, ' ', words);
+        pmr::vector<Word> warWords(memory);
+        pmr::vector<Word> peaceWords(memory);
+        filterWarTerms(words, warWords);
+        filterPeaceTerms(words, peaceWords);
+        pmr::map<string, pmr::vector<Word>> warMap(memory);
+        pmr::map<string, pmr::vector<Word>> peaceMap(memory);
+        map_words_into(warWords, warMap);
+        map_words_into(peaceWords, peaceMap);
+        pmr::vector<WordCount> warResult(memory);
+        pmr::vector<WordCount> peaceResult(memory);
+        calculate_wordCount_into(warMap, warResult);
+        calculate_wordCount_into(peaceMap, peaceResult);
+        int warValue = get_relation_value(warResult, calculate_density(warWords));
+        int peaceValue = get_relation_value(peaceResult, calculate_density(peaceWords));
+        return warValue > peaceValue ? Relation::WAR : Relation::PEACE;
+    };
+
+    ChapterArena& arena = chapter_arena();
+    auto run = [&](const string& name, const auto& relation) {
+        measure(name, [&]() {
+            return accumulate(chapters.begin(), chapters.end(), 0, [&](int warChapters, const string_view chapter) {
+                int war = relation(chapter) == Relation::WAR ? 1 : 0;
+                arena.reset();
+                return warChapters + war;
+            });
+        });
+    };
+
+    run("vector of Word", [&](const string_view chapter) { return summarize_words(chapter, arena.resource()); });
+    run("token block", [&](const string_view chapter) {
+        return summarize_chapter_with(chapter, arena.resource())(filterPeaceTerms, filterWarTerms).relation;
+    });
+};
+
+auto benchmark_word_counting = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== word counting ==" << endl;
+
+    vector<string> terms = peaceTerms;
+    terms.insert(terms.end(), warTerms.begin(), warTerms.end());
+
+    const vector<Word> words = filter_words(tokenize(book, ' '), terms);
+    measure("map_words + calculate_wordCount", [&]() { return calculate_wordCount(map_words(words)).size(); });
+
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block(book, ' ', dictionary, block);
+    pmr::vector<uint8_t> matches;
+    classify_terms(bind(filter_words_into, _1, cref(terms), _2), dictionary, matches);
+    TokenBlock filtered;
+    filter_block_into(block, matches, filtered);
+    measure("term table", [&]() {
+        TermTable table;
+        count_block_terms_into(filtered, table);
+        return table.size;
+    });
+};
+
+auto benchmark_scoring_modes = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== scoring modes ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+
+    // Bytes a chapter asks for in total, growing vectors count every size they had
+    struct CountingResource : pmr::memory_resource {
+        size_t bytes = 0;
+
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* pointer, size_t size, size_t alignment) override {
+            pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+        }
+        bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    auto run = [&](const string& name, const auto& score) {
+        size_t largestChapter = 0;
+        for (const string_view chapter : chapters) {
+            CountingResource counting;
+            score(chapter, &counting);
+            largestChapter = max(largestChapter, counting.bytes);
+        }
+        ChapterArena& arena = chapter_arena();
+        measure(name, [&]() {
+            return accumulate(chapters.begin(), chapters.end(), 0, [&](int warHits, const string_view chapter) {
+                int hits = score(chapter, arena.resource());
+                arena.reset();
+                return warHits + hits;
+            });
+        });
+        cout << "  bytes allocated for the largest chapter: " << largestChapter << endl;
+    };
+
+    run("count-only", [&](const string_view chapter, pmr::memory_resource* memory) {
+        return summarize_chapter_with(chapter, memory)(filterPeaceTerms, filterWarTerms).warHits;
+    });
+    run("verbose", [&](const string_view chapter, pmr::memory_resource* memory) {
+        return detail_chapter_with(chapter, memory)(filterPeaceTerms, filterWarTerms).summary.warHits;
+    });
+};
+
+auto benchmark_position_lists = [](const string& book) {
+    cout << "== position index of every term ==" << endl;
+
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block(book, ' ', dictionary, block);
+
+    const auto words = measure("map_words", [&]() { return map_words(tokenize(book, ' ')); });
+    const auto raw = measure("vector<uint32_t> per term", [&]() {
+        vector<vector<uint32_t>> index(dictionary.size());
+        for (size_t i = 0; i < block.size(); i++) {
+            index[block.termIds[i]].push_back(block.positions[i]);
+        }
+        for (auto& positions : index) {
+            positions.shrink_to_fit();
+        }
+        return index;
+    });
+    const auto compressed = measure("PositionIndex", [&]() { return build_position_index(block, dictionary.size()); });
+
+    size_t wordBytes = 0;
+    for (const auto& [term, termWords] : words) {
+        wordBytes += termWords.capacity() * sizeof(Word);
+        for (const Word& word : termWords) {
+            wordBytes += word.str.capacity() > 15 ? word.str.capacity() + 1 : 0;
+        }
+    }
+    size_t rawBytes = accumulate(raw.begin(), raw.end(), size_t(0), [](size_t sum, const vector<uint32_t>& positions) {
+        return sum + sizeof(positions) + positions.capacity() * sizeof(uint32_t);
+    });
+    size_t compressedBytes = compressed.memory();
+    cout << "  " << block.size() << " positions of " << dictionary.size() << " terms" << endl;
+    cout << "  vector<Word>: " << wordBytes / 1024 << " KiB, vector<uint32_t>: " << rawBytes / 1024
+         << " KiB, PositionIndex: " << compressedBytes / 1024 << " KiB" << endl;
+
+    auto sumRaw = measure("iterate vector<uint32_t>", [&]() {
+        uint64_t sum = 0;
+        for (const auto& positions : raw) {
+            for (uint32_t position : positions) {
+                sum += position;
+            }
+        }
+        return sum;
+    });
+    auto sumCompressed = measure("iterate PositionIndex", [&]() {
+        uint64_t sum = 0;
+        for (uint32_t termId = 0; termId < compressed.size(); termId++) {
+            for_each_position(compressed.list(termId), [&](const uint32_t position) { sum += position; });
+        }
+        return sum;
+    });
+    cout << "  same positions: " << (sumRaw == sumCompressed ? "yes" : "no") << endl;
+};
+
+auto benchmark_thread_scaling = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== chapters on a thread pool (" << default_thread_count() << " hardware threads) ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+
+    const auto serial = measure("serial", [&]() { return process_all_chapters(chapters)(filterPeaceTerms, filterWarTerms); });
+    for (size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        ThreadPool pool(threads);
+        process_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms); // sizes the arenas of the workers
+        auto start = chrono::steady_clock::now();
+        auto parallel = process_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms);
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << threads << " threads: " << elapsed << " ms" << (parallel == serial ? "" : " (differs from serial)") << endl;
+    }
+
+    cout << "== parallel algorithms (" << parallel_backend() << ") vs thread pool ==" << endl;
+    process_all_chapters_parallel_stl(chapters)(filterPeaceTerms, filterWarTerms); // sizes the arenas of the workers
+    const auto parallelStl = measure("process_all_chapters_parallel_stl", [&]() {
+        return process_all_chapters_parallel_stl(chapters)(filterPeaceTerms, filterWarTerms);
+    });
+    ThreadPool pool(default_thread_count());
+    process_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms);
+    const auto pooled = measure("process_all_chapters_parallel", [&]() { return process_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms); });
+    cout << (parallelStl == serial && pooled == serial ? "same relations as serial" : "relations differ from serial") << endl;
+
+    cout << "== work stealing ==" << endl;
+    for (size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        const size_t grainSize = default_grain_size(book.size(), threads);
+        auto start = chrono::steady_clock::now();
+        auto run = summarize_all_chapters_stealing(chapters, threads, grainSize)(filterPeaceTerms, filterWarTerms);
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        size_t steals = 0;
+        size_t splits = 0;
+        double utilization = 0;
+        for (const WorkerStats& worker : run.workers) {
+            steals += worker.steals;
+            splits += worker.splits;
+            utilization += worker.utilization() / run.workers.size();
+        }
+        cout << threads << " threads: " << elapsed << " ms, " << steals << " steals, " << splits << " splits, "
+             << int(utilization * 100 + 0.5) << "% mean utilization" << endl;
+        if (threads == 4) {
+            print_worker_stats(cout, run.workers);
+        }
+    }
+};
+
+// Time until chapter 1 is known: the batch path reads and splits the whole book first, the pipeline
+// only needs the bytes up to the second heading. copies times the book's body makes a longer book.
+auto benchmark_first_chapter_latency = [](const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== first chapter latency, batch vs pipeline ==" << endl;
+
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+    const string text = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(text);
+
+    for (size_t copies : {1, 8}) {
+        const string bookPath = "./out/bench_book.txt";
+        {
+            ofstream out(bookPath, ios::binary);
+            out << text.substr(0, body.begin);
+            for (size_t i = 0; i < copies; i++) {
+                out << text.substr(body.begin, body.end - body.begin);
+            }
+            out << text.substr(body.end);
+        }
+
+        auto start = chrono::steady_clock::now();
+        auto book = read_text(bookPath).value();
+        const auto bookBody = find_gutenberg_body(book);
+        const auto flat = flatten_lines(book.substr(bookBody.begin, bookBody.end - bookBody.begin));
+        const auto chapters = split_book_into_chapter_views(flat);
+        auto first = summarize_chapter(chapters.front())(filterPeaceTerms, filterWarTerms);
+        auto batch = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        auto stats = stream_chapters(bookPath, default_thread_count(), defaultReorderWindow, [](int, const ChapterSummary&) {})(filterPeaceTerms, filterWarTerms);
+        cout << copies << "x book (" << book.size() << " bytes): batch " << batch << " ms, pipeline " << stats->firstChapterMilliseconds
+             << " ms to the first chapter (" << relationToString(first.relation) << "), pipeline total " << stats->totalMilliseconds << " ms" << endl;
+        remove(bookPath.c_str());
+    }
+};
+
+// Corpus-wide counting of every term: shards per worker merged at the end vs one map behind a mutex
+// that every worker adds its tokens to. The corpus is the book's chapters eight times.
+auto benchmark_corpus_counting = [](const string& book) {
+    cout << "== corpus term counting (" << default_thread_count() << " hardware threads) ==" << endl;
+
+    const auto bookChapters = split_book_into_chapter_views(book);
+    vector<string_view> corpus;
+    for (int copy = 0; copy < 8; copy++) {
+        corpus.insert(corpus.end(), bookChapters.begin(), bookChapters.end());
+    }
+
+    for (size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        ThreadPool pool(threads);
+        auto start = chrono::steady_clock::now();
+        const auto sharded = count_corpus_terms(corpus, pool);
+        auto shardedElapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        unordered_map<string, uint64_t> shared;
+        mutex sharedGuard;
+        atomic<size_t> next{0};
+        for (size_t worker = 0; worker < threads; worker++) {
+            pool.submit([&]() {
+                for (size_t i = next++; i < corpus.size(); i = next++) {
+                    TermDictionary dictionary;
+                    TokenBlock block;
+                    tokenize_block(corpus[i], ' ', dictionary, block);
+                    for (const uint32_t termId : block.termIds) {
+                        lock_guard<mutex> lock(sharedGuard);
+                        shared[string(dictionary.term(termId))]++;
+                    }
+                }
+            });
+        }
+        pool.wait();
+        auto sharedElapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        cout << threads << " threads: shards " << shardedElapsed << " ms, shared map " << sharedElapsed << " ms"
+             << (shared.size() == sharded.counts.size() ? "" : " (different term counts)") << endl;
+    }
+};
+
+// Throughput per node with the chapters split between the NUMA nodes, without and with every worker
+// pinned to a core
+auto benchmark_numa_placement = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    const auto topology = numa_topology();
+    cout << "== NUMA placement (" << topology.size() << " nodes, " << topology_cpus(topology).size() << " CPUs) ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+    const size_t threadsPerNode = max<size_t>(default_thread_count() / topology.size(), 1);
+    for (bool pinCores : {false, true}) {
+        cout << (pinCores ? "workers pinned to cores:" : "workers pinned to nodes:") << endl;
+        auto run = summarize_all_chapters_numa(chapters, topology, threadsPerNode, pinCores)(filterPeaceTerms, filterWarTerms);
+        print_node_stats(cout, run.nodes);
+    }
+};
+
+// The same number of worker processes as of threads; the processes include forking and reaping
+auto benchmark_worker_processes = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    cout << "== worker processes vs threads ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+    auto relations = [](const vector<ChapterSummary>& summaries) {
+        vector<Relation> result(summaries.size());
+        transform(summaries.begin(), summaries.end(), result.begin(), [](const ChapterSummary& summary) { return summary.relation; });
+        return result;
+    };
+    for (size_t workers : {1, 2, 4, 8}) {
+        ThreadPool pool(workers);
+        summarize_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms); // sizes the arenas of the workers
+        auto start = chrono::steady_clock::now();
+        const auto threaded = summarize_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms);
+        const auto threadedMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        const auto forked = summarize_all_chapters_forked(chapters, workers)(filterPeaceTerms, filterWarTerms);
+        if (!forked.has_value()) {
+            cout << "no shared memory for the worker processes" << endl;
+            return;
+        }
+        cout << workers << " workers: threads " << threadedMilliseconds << " ms, processes " << forked->stats.milliseconds << " ms"
+             << (relations(forked->summaries) == relations(threaded) ? "" : " (relations differ)") << endl;
+    }
+};
+
+// When the first chapter reaches the output: after all of them with the batch path, as soon as it is
+// done when the results are streamed through a reorder buffer of the given window
+auto benchmark_ordered_streaming = [](const string& book, const vector<string>& peaceTerms, const vector<string>& warTerms) {
+    const size_t threads = max<size_t>(default_thread_count(), 4);
+    cout << "== ordered streaming (" << threads << " threads) ==" << endl;
+
+    const auto chapters = split_book_into_chapter_views(book);
+    auto filterPeaceTerms = bind(filter_words_into, _1, cref(peaceTerms), _2);
+    auto filterWarTerms = bind(filter_words_into, _1, cref(warTerms), _2);
+    ThreadPool pool(threads);
+    measure("batch, first chapter after all", [&]() { return process_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms); });
+    for (size_t window : {1, 4, 16, 64}) {
+        const auto start = chrono::steady_clock::now();
+        double first = 0;
+        auto emit = [&](const int chapter, const ChapterSummary&) {
+            if (chapter == 1) {
+                first = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            }
+        };
+        const auto stats = stream_all_chapters_parallel(chapters, pool, window, emit)(filterPeaceTerms, filterWarTerms);
+        const auto total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "window " << window << ": first chapter after " << first << " ms, all after " << total << " ms, " << stats.roomWaits
+             << " waits for the window, at most " << stats.peakBuffered << " buffered" << endl;
+    }
+};
+
+int main() {
+    auto peaceTerms = read_terms("./data/peace_terms.txt");
+    auto warTerms = read_terms("./data/war_terms.txt");
+    auto book = read_lines("./data/book.txt");
+    if(!peaceTerms.has_value() || !warTerms.has_value() || !book.has_value()){
+        cout << "Error reading the input files" << endl;
+        return 1;
+    }
+
+    const auto bookString = concatenate_lines(book.value());
+    benchmark_boilerplate_stripping(bookString);
+    benchmark_chapter_splitting(bookString);
+
+    const auto words = measure("tokenize", [&]() { return tokenize(bookString, ' '); });
+
+    benchmark_fuzzy_matching(words, warTerms.value());
+    benchmark_fuzzy_matching(words, peaceTerms.value());
+    benchmark_compiled_matching(words, peaceTerms.value(), warTerms.value());
+    benchmark_chapter_selection(peaceTerms.value(), warTerms.value());
+    benchmark_chapter_arena(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_token_layout(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_word_counting(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_scoring_modes(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_position_lists(bookString);
+    benchmark_thread_scaling(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_first_chapter_latency(peaceTerms.value(), warTerms.value());
+    benchmark_corpus_counting(bookString);
+    benchmark_numa_placement(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_worker_processes(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_ordered_streaming(bookString, peaceTerms.value(), warTerms.value());
+    benchmark_lexicon_loading(1000);
+    benchmark_lexicon_loading(200000);
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "TextAnalyzer.h"
+
+// Analyzing a few chapters without reading the whole book: the chapter offsets are kept in a small
+// sidecar file, so a selection only reads the byte ranges of the selected chapters. The offsets are
+// those of find_chapter_ranges on the Gutenberg body, relative to the start of the file.
+#pragma region chapter selection
+constexpr char chapterSidecarMagic[8] = {'T', 'X', 'C', 'H', 'A', 'P', 'I', 'X'};
+
+struct BookFingerprint {
+    uint64_t size;
+    int64_t modified;
+
+    bool operator==(const BookFingerprint& other) const {
+        return size == other.size && modified == other.modified;
+    }
+};
+
+struct ChapterSidecar {
+    BookFingerprint book;
+    vector<ChapterRange> chapters;
+};
+
+auto fingerprint_book = [](const string& bookPath) -> optional<BookFingerprint> {
+    error_code error;
+    auto size = filesystem::file_size(bookPath, error);
+    if(error){
+        return nullopt;
+    }
+    auto modified = filesystem::last_write_time(bookPath, error);
+    if(error){
+        return nullopt;
+    }
+    return BookFingerprint{uint64_t(size), int64_t(modified.time_since_epoch().count())};
+};
+
+auto write_chapter_sidecar = [](const string& sidecarPath, const ChapterSidecar& sidecar) -> bool {
+    ofstream output(sidecarPath, ios::binary | ios::trunc);
+    uint64_t count = sidecar.chapters.size();
+    output.write(chapterSidecarMagic, sizeof(chapterSidecarMagic));
+    output.write(reinterpret_cast<const char*>(&sidecar.book), sizeof(sidecar.book));
+    output.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for_each(sidecar.chapters.begin(), sidecar.chapters.end(), [&output](const ChapterRange& range) {
+        uint64_t offsets[2] = {range.begin, range.end};
+        output.write(reinterpret_cast<const char*>(offsets), sizeof(offsets));
+    });
+    return bool(output);
+};
+
+auto read_chapter_sidecar = [](const string& sidecarPath) -> optional<ChapterSidecar> {
+    ifstream input(sidecarPath, ios::binary);
+    char magic[sizeof(chapterSidecarMagic)];
+    ChapterSidecar sidecar{};
+    uint64_t count = 0;
+    input.read(magic, sizeof(magic));
+    input.read(reinterpret_cast<char*>(&sidecar.book), sizeof(sidecar.book));
+    input.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if(!input || memcmp(magic, chapterSidecarMagic, sizeof(magic)) != 0 || count > sidecar.book.size){
+        return nullopt;
+    }
+
+    sidecar.chapters.resize(count);
+    for(auto& range : sidecar.chapters){
+        uint64_t offsets[2];
+        input.read(reinterpret_cast<char*>(offsets), sizeof(offsets));
+        if(!input || offsets[0] > offsets[1] || offsets[1] > sidecar.book.size){
+            return nullopt;
+        }
+        range = ChapterRange{size_t(offsets[0]), size_t(offsets[1])};
+    }
+    return sidecar;
+};
+
+// The full scan, used when there is no up-to-date sidecar
+auto scan_chapter_ranges = [](const string& bookPath) -> optional<vector<ChapterRange>> {
+    auto text = read_text(bookPath);
+    if(!text.has_value()){
+        return nullopt;
+    }
+    const auto body = find_gutenberg_body(text.value());
+    auto chapters = find_chapter_ranges(string_view(text.value()).substr(body.begin, body.end - body.begin));
+    for_each(chapters.begin(), chapters.end(), [&body](ChapterRange& range) {
+        range.begin += body.begin;
+        range.end += body.begin;
+    });
+    return chapters;
+};
+
+// Uses the sidecar while it matches the size and modification time of the book, otherwise scans
+// the book and writes a new sidecar; failing to write it only costs the next run another scan
+auto load_chapter_ranges = [](const string& bookPath, const string& sidecarPath) -> optional<vector<ChapterRange>> {
+    auto book = fingerprint_book(bookPath);
+    if(!book.has_value()){
+        return nullopt;
+    }
+
+    auto sidecar = read_chapter_sidecar(sidecarPath);
+    if(sidecar.has_value() && sidecar->book == book.value()){
+        return sidecar->chapters;
+    }
+
+    auto chapters = scan_chapter_ranges(bookPath);
+    if(chapters.has_value()){
+        write_chapter_sidecar(sidecarPath, ChapterSidecar{book.value(), chapters.value()});
+    }
+    return chapters;
+};
+
+// Reads just this range of the file, flattened like the whole book would be
+auto read_text_range = [](const string& filePath, const ChapterRange& range) -> optional<string> {
+    ifstream input(filePath, ios::binary);
+    if(!input.is_open()){
+        return nullopt;
+    }
+    string text(range.end - range.begin, '\0');
+    input.seekg(range.begin);
+    input.read(text.data(), text.size());
+    if(!input){
+        return nullopt;
+    }
+    return flatten_lines(std::move(text));
+};
+
+// "N" or "N..M", counting chapters from 1 like print_evaluations
+auto parse_chapter_selection = [](const string& selection) -> optional<pair<int, int>> {
+    size_t dots = selection.find("..");
+    string first = selection.substr(0, dots);
+    string last = dots == string::npos ? first : selection.substr(dots + 2);
+    auto is_number = [](const string& text) {
+        return !text.empty() && text.size() < 10 && all_of(text.begin(), text.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); });
+    };
+    if(!is_number(first) || !is_number(last) || stoi(first) < 1 || stoi(first) > stoi(last)){
+        return nullopt;
+    }
+    return make_pair(stoi(first), stoi(last));
+};
+
+// nullopt if the selection goes past the last chapter or a chapter cannot be read
+auto process_chapter_selection = [](const string& bookPath, const vector<ChapterRange>& chapters, const pair<int, int>& selection) {
+    return [&bookPath, &chapters, selection](const auto& filterPeaceTerms, const auto& filterWarTerms) -> optional<map<int, Relation>> {
+        if(size_t(selection.second) > chapters.size()){
+            return nullopt;
+        }
+        map<int, Relation> chapter_densities;
+        for(int number = selection.first; number <= selection.second; number++){
+            auto chapter = read_text_range(bookPath, chapters[number - 1]);
+            if(!chapter.has_value()){
+                return nullopt;
+            }
+            chapter_densities[number] = process_chapter(chapter.value())(filterPeaceTerms, filterWarTerms);
+        }
+        return chapter_densities;
+    };
+};
+#pragma endregion chapter selection
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "TextAnalyzer.h"
+
+// Binary lexicon that is used in place after mapping the file. All references inside the blob are
+// offsets from its start, so it can be mapped at any address. Integers are stored in the byte order
+// of the machine that compiled the lexicon; the header records it, and a blob of the other byte order
+// is rejected instead of being misread.
+//
+//   CompiledLexiconHeader
+//   CompiledTerm[termCount]   sorted as compiled, each with its category mask and weight
+//   uint32_t[slotCount]       open-addressing table of term index + 1, 0 marks an empty slot
+//   char[poolSize]            term spellings, not null-terminated
+#pragma region compiled lexicon
+constexpr char compiledLexiconMagic[8] = {'T', 'X', 'L', 'E', 'X', 'B', 'I', 'N'};
+constexpr uint32_t compiledLexiconVersion = 2;
+// Reads as 0x04030201 on a machine of the other byte order
+constexpr uint32_t compiledLexiconByteOrder = 0x01020304;
+
+struct CompiledLexiconHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t termCount;
+    uint32_t slotCount;
+    uint32_t poolSize;
+    uint32_t reserved;
+    uint64_t termsOffset;
+    uint64_t slotsOffset;
+    uint64_t poolOffset;
+};
+
+struct CompiledTerm {
+    uint32_t poolOffset;
+    uint32_t hash;
+    uint16_t length;
+    uint8_t categoryMask;
+    uint8_t reserved;
+    float weight;
+};
+
+constexpr uint8_t category_bit(const Relation category) {
+    return uint8_t(1u << static_cast<int>(category));
+}
+
+// FNV-1a, cheap for the short words we look up
+constexpr uint32_t hash_term(const string_view term) {
+    uint32_t hash = 2166136261u;
+    for(unsigned char c : term){
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// The term files carry no weights and the relation values only count hits, so every term gets this
+constexpr float defaultTermWeight = 1.0f;
+
+struct LexiconEntry {
+    string term;
+    uint8_t categoryMask;
+    float weight;
+};
+
+// Merges both lists in order of first appearance, a term listed in both gets both category bits
+auto collect_lexicon_entries = [](const vector<string>& peaceTerms, const vector<string>& warTerms) -> vector<LexiconEntry> {
+    vector<LexiconEntry> entries;
+    unordered_map<string, size_t> ids;
+
+    // the whole line is the term, as filter_words matches it
+    auto add = [&](const string& term, const Relation category) {
+        if(term.empty()){
+            return;
+        }
+        auto known = ids.find(term);
+        if(known != ids.end()){
+            entries[known->second].categoryMask |= category_bit(category);
+            return;
+        }
+        ids.emplace(term, entries.size());
+        entries.push_back(LexiconEntry{term, category_bit(category), defaultTermWeight});
+    };
+    for_each(peaceTerms.begin(), peaceTerms.end(), bind(add, _1, Relation::PEACE));
+    for_each(warTerms.begin(), warTerms.end(), bind(add, _1, Relation::WAR));
+
+    return entries;
+};
+
+auto compile_lexicon = [](const vector<string>& peaceTerms, const vector<string>& warTerms) -> vector<char> {
+    const auto entries = collect_lexicon_entries(peaceTerms, warTerms);
+    vector<CompiledTerm> terms;
+    string pool;
+    for_each(entries.begin(), entries.end(), [&](const LexiconEntry& entry){
+        terms.push_back(CompiledTerm{uint32_t(pool.size()), hash_term(entry.term), uint16_t(entry.term.size()),
+                                     entry.categoryMask, 0, entry.weight});
+        pool += entry.term;
+    });
+
+    // at most half full so probe sequences stay short
+    uint32_t slotCount = 16;
+    while(slotCount < terms.size() * 2){
+        slotCount *= 2;
+    }
+    vector<uint32_t> slots(slotCount, 0);
+    for(uint32_t id = 0; id < terms.size(); id++){
+        uint32_t slot = terms[id].hash & (slotCount - 1);
+        while(slots[slot] != 0){
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = id + 1;
+    }
+
+    CompiledLexiconHeader header{};
+    memcpy(header.magic, compiledLexiconMagic, sizeof(header.magic));
+    header.version = compiledLexiconVersion;
+    header.byteOrder = compiledLexiconByteOrder;
+    header.termCount = uint32_t(terms.size());
+    header.slotCount = slotCount;
+    header.poolSize = uint32_t(pool.size());
+    header.termsOffset = sizeof(CompiledLexiconHeader);
+    header.slotsOffset = header.termsOffset + terms.size() * sizeof(CompiledTerm);
+    header.poolOffset = header.slotsOffset + slots.size() * sizeof(uint32_t);
+
+    vector<char> blob(header.poolOffset + pool.size());
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + header.termsOffset, terms.data(), terms.size() * sizeof(CompiledTerm));
+    memcpy(blob.data() + header.slotsOffset, slots.data(), slots.size() * sizeof(uint32_t));
+    memcpy(blob.data() + header.poolOffset, pool.data(), pool.size());
+    return blob;
+};
+
+auto write_compiled_lexicon = [](const string& filePath, const vector<char>& blob) -> bool {
+    ofstream output(filePath, ios::binary | ios::trunc);
+    output.write(blob.data(), blob.size());
+    return bool(output);
+};
+
+// Read-only view of a compiled lexicon; owns the mapping (or the buffer it was read into)
+struct CompiledLexicon {
+    const char* base = nullptr;
+    size_t size = 0;
+    shared_ptr<const void> storage;
+
+    const CompiledLexiconHeader& header() const {
+        return *reinterpret_cast<const CompiledLexiconHeader*>(base);
+    }
+    const CompiledTerm* terms() const {
+        return reinterpret_cast<const CompiledTerm*>(base + header().termsOffset);
+    }
+    const uint32_t* slots() const {
+        return reinterpret_cast<const uint32_t*>(base + header().slotsOffset);
+    }
+    string_view spelling(const CompiledTerm& term) const {
+        return string_view(base + header().poolOffset + term.poolOffset, term.length);
+    }
+};
+
+// Checks the layout only, so it costs the same for any lexicon size; the lookups bound-check
+// the slots and terms they actually touch
+auto validate_compiled_lexicon = [](const CompiledLexicon& lexicon) -> bool {
+    if(lexicon.size < sizeof(CompiledLexiconHeader)){
+        return false;
+    }
+    const auto& header = lexicon.header();
+    if(memcmp(header.magic, compiledLexiconMagic, sizeof(header.magic)) != 0 || header.version != compiledLexiconVersion
+       || header.byteOrder != compiledLexiconByteOrder){
+        return false;
+    }
+    if(header.slotCount == 0 || (header.slotCount & (header.slotCount - 1)) != 0 || header.slotCount <= header.termCount){
+        return false;
+    }
+    return header.termsOffset == sizeof(CompiledLexiconHeader)
+        && header.slotsOffset == header.termsOffset + uint64_t(header.termCount) * sizeof(CompiledTerm)
+        && header.poolOffset == header.slotsOffset + uint64_t(header.slotCount) * sizeof(uint32_t)
+        && header.poolOffset + header.poolSize == lexicon.size;
+};
+
+auto view_compiled_lexicon = [](const char* base, size_t size, shared_ptr<const void> storage) -> optional<CompiledLexicon> {
+    CompiledLexicon lexicon{base, size, std::move(storage)};
+    if(!validate_compiled_lexicon(lexicon)){
+        return nullopt;
+    }
+    return lexicon;
+};
+
+// Maps the file instead of parsing it, so loading costs the same for ten terms or a million
+auto load_compiled_lexicon = [](const string& filePath) -> optional<CompiledLexicon> {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return nullopt;
+    }
+    struct stat status;
+    if(fstat(fd, &status) != 0 || status.st_size <= 0){
+        close(fd);
+        return nullopt;
+    }
+    size_t size = size_t(status.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        return nullopt;
+    }
+    shared_ptr<const void> storage(mapped, [size](const void* address){
+        munmap(const_cast<void*>(address), size);
+    });
+    return view_compiled_lexicon(static_cast<const char*>(mapped), size, storage);
+#else
+    ifstream input(filePath, ios::binary);
+    if(!input.is_open()){
+        return nullopt;
+    }
+    auto buffer = make_shared<vector<char>>(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    return view_compiled_lexicon(buffer->data(), buffer->size(), buffer);
+#endif
+};
+
+auto find_compiled_term = [](const CompiledLexicon& lexicon, const string_view word) -> const CompiledTerm* {
+    const uint32_t mask = lexicon.header().slotCount - 1;
+    const uint32_t hash = hash_term(word);
+    const uint32_t* slots = lexicon.slots();
+    const auto& header = lexicon.header();
+    // a damaged table may have no empty slot, so no probe visits more than every slot once
+    uint32_t slot = hash & mask;
+    for(uint32_t probes = 0; probes < header.slotCount && slots[slot] != 0; probes++, slot = (slot + 1) & mask){
+        if(slots[slot] > header.termCount){
+            return nullptr;
+        }
+        const CompiledTerm& term = lexicon.terms()[slots[slot] - 1];
+        if(uint64_t(term.poolOffset) + term.length > header.poolSize){
+            return nullptr;
+        }
+        if(term.hash == hash && lexicon.spelling(term) == word){
+            return &term;
+        }
+    }
+    return nullptr;
+};
+
+// Same shape as filter_words, with the category selecting which terms of the lexicon count
+auto compiled_filter_words_into = [](const auto& words, const CompiledLexicon& lexicon, const Relation category, auto& filterWords) {
+    copy_if(words.begin(), words.end(), back_inserter(filterWords), [&](const Word& word){
+        const CompiledTerm* term = find_compiled_term(lexicon, word.str);
+        return term != nullptr && (term->categoryMask & category_bit(category)) != 0;
+    });
+};
+
+auto compiled_filter_words = [](const vector<Word>& words, const CompiledLexicon& lexicon, const Relation category) -> vector<Word> {
+    vector<Word> filterWords;
+    compiled_filter_words_into(words, lexicon, category, filterWords);
+    return filterWords;
+};
+#pragma endregion compiled lexicon
+
+#pragma region generated matcher
+// The bytes at offset..offset+width of the term as the little-endian integer a width-byte load returns
+auto little_endian_constant = [](const string& term, const size_t offset, const size_t width) -> string {
+    uint64_t value = 0;
+    for(size_t i = 0; i < width; i++){
+        value |= uint64_t(static_cast<unsigned char>(term[offset + i])) << (8 * i);
+    }
+    ostringstream hex;
+    hex << "0x" << std::hex << value << (width == 8 ? "ull" : "u");
+    return hex.str();
+};
+
+// Compares everything after the first byte with as few 8, 4, 2 and 1 byte loads as possible
+auto fixed_width_compare = [](const string& term) -> string {
+    vector<string> compares;
+    for(size_t offset = 1; offset < term.size();){
+        size_t remaining = term.size() - offset;
+        size_t width = remaining >= 8 ? 8 : remaining >= 4 ? 4 : remaining >= 2 ? 2 : 1;
+        compares.push_back("generated_load" + to_string(width * 8) + "(s + " + to_string(offset) + ") == "
+                           + little_endian_constant(term, offset, width));
+        offset += width;
+    }
+    if(compares.empty()){
+        return "true";
+    }
+    return accumulate(compares.begin() + 1, compares.end(), compares.front(), [](const string& accumulator, const string& compare){
+        return accumulator + " && " + compare;
+    });
+};
+
+auto char_literal = [](const char c) -> string {
+    if(c == '\'' || c == '\\'){
+        return string("'\\") + c + "'";
+    }
+    if(isprint(static_cast<unsigned char>(c))){
+        return string("'") + c + "'";
+    }
+    return "char(" + to_string(int(static_cast<unsigned char>(c))) + ")";
+};
+
+// Emits generated_category_mask(s, n): a switch over the token length, then over its first byte,
+// ending in fixed-width compares of the remaining bytes; it returns the category mask or 0
+auto generate_matcher_source = [](const vector<string>& peaceTerms, const vector<string>& warTerms) -> string {
+    auto entries = collect_lexicon_entries(peaceTerms, warTerms);
+    stable_sort(entries.begin(), entries.end(), [](const LexiconEntry& a, const LexiconEntry& b){
+        return make_pair(a.term.size(), a.term[0]) < make_pair(b.term.size(), b.term[0]);
+    });
+
+    ostringstream source;
+    source << "// Generated by LexiconCompiler --cpp, do not edit\n"
+              "#pragma once\n\n"
+              "#include <cstddef>\n"
+              "#include <cstdint>\n"
+              "#include <cstring>\n\n"
+              "#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__\n"
+              "#error \"the generated matcher compares little-endian loads\"\n"
+              "#endif\n\n"
+              "inline uint64_t generated_load64(const char* s) { uint64_t v; memcpy(&v, s, 8); return v; }\n"
+              "inline uint32_t generated_load32(const char* s) { uint32_t v; memcpy(&v, s, 4); return v; }\n"
+              "inline uint16_t generated_load16(const char* s) { uint16_t v; memcpy(&v, s, 2); return v; }\n"
+              "inline uint8_t generated_load8(const char* s) { return uint8_t(*s); }\n\n"
+              "constexpr size_t generated_term_count = " << entries.size() << ";\n\n"
+              "inline uint8_t generated_category_mask(const char* s, size_t n) {\n"
+              "    switch(n){\n";
+
+    for(size_t i = 0; i < entries.size();){
+        const size_t length = entries[i].term.size();
+        source << "    case " << length << ":\n"
+                  "        switch(s[0]){\n";
+        while(i < entries.size() && entries[i].term.size() == length){
+            const char first = entries[i].term[0];
+            source << "        case " << char_literal(first) << ":\n";
+            for(; i < entries.size() && entries[i].term.size() == length && entries[i].term[0] == first; i++){
+                source << "            if(" << fixed_width_compare(entries[i].term) << ") return "
+                       << int(entries[i].categoryMask) << ";\n";
+            }
+            source << "            break;\n";
+        }
+        source << "        }\n"
+                  "        break;\n";
+    }
+
+    source << "    }\n"
+              "    return 0;\n"
+              "}\n";
+    return source.str();
+};
+
+auto write_matcher_source = [](const string& filePath, const string& source) -> bool {
+    ofstream output(filePath, ios::trunc);
+    output << source;
+    return bool(output);
+};
+#pragma endregion generated matcher
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+// Term frequencies over any number of chapters, e.g. of all books of a corpus. Every worker counts
+// into its own shard, a dictionary of the terms it has seen and a count per term id of that
+// dictionary, so no table is shared while counting. At the end the shards are merged pairwise in
+// log2(workers) rounds, the merges of a round run in parallel.
+#pragma region corpus statistics
+struct TermCountShard {
+    TermDictionary dictionary;
+    vector<uint64_t> counts;
+
+    // The ids of the block are ids of this shard's dictionary
+    void count_block(const TokenBlock& block) {
+        counts.resize(dictionary.size(), 0);
+        for (const uint32_t termId : block.termIds) {
+            counts[termId]++;
+        }
+    }
+
+    // Adds the counts of another shard, whose ids are its own
+    void merge(const TermCountShard& other) {
+        for (uint32_t id = 0; id < other.counts.size(); id++) {
+            const uint32_t mine = dictionary.intern(other.dictionary.term(id));
+            if (mine >= counts.size()) {
+                counts.resize(mine + 1, 0);
+            }
+            counts[mine] += other.counts[id];
+        }
+    }
+
+    uint64_t total() const {
+        return accumulate(counts.begin(), counts.end(), uint64_t{0});
+    }
+};
+
+// Only the term spellings stay in the shard, the tokens live in the arena of the calling thread
+auto count_chapter_terms_into = [](const string_view chapter, TermCountShard& shard) {
+    ChapterArena& arena = chapter_arena();
+    {
+        TokenBlock block(arena.resource());
+        tokenize_block(chapter, ' ', shard.dictionary, block);
+        shard.count_block(block);
+    }
+    arena.reset();
+};
+
+// Round after round shard i takes in shard i + stride, with the stride doubling; shards.front() ends
+// up with every count
+auto reduce_shards = [](vector<TermCountShard>& shards, ThreadPool& pool) -> TermCountShard& {
+    for (size_t stride = 1; stride < shards.size(); stride *= 2) {
+        for (size_t i = 0; i + stride < shards.size(); i += 2 * stride) {
+            pool.submit([&shards, i, stride]() { shards[i].merge(shards[i + stride]); });
+        }
+        pool.wait();
+    }
+    return shards.front();
+};
+
+// chapters may come from any number of books; each worker of the pool takes the next chapter until
+// all are counted
+auto count_corpus_terms = [](const auto& chapters, ThreadPool& pool) -> TermCountShard {
+    vector<TermCountShard> shards(pool.size());
+    atomic<size_t> next{0};
+    for (size_t worker = 0; worker < shards.size(); worker++) {
+        pool.submit([&chapters, &shards, &next, worker]() {
+            for (size_t i = next++; i < chapters.size(); i = next++) {
+                count_chapter_terms_into(chapters[i], shards[worker]);
+            }
+        });
+    }
+    pool.wait();
+    return std::move(reduce_shards(shards, pool));
+};
+
+// WordCount with the count of the shards, which a corpus can take past the range of an int
+struct CorpusWordCount {
+    string word;
+    uint64_t count;
+
+    bool operator==(const CorpusWordCount& other) const {
+        return word == other.word && count == other.count;
+    }
+};
+
+// Most frequent first, ties by word; limit 0 keeps every term
+auto corpus_word_counts = [](const TermCountShard& corpus, const size_t limit) -> vector<CorpusWordCount> {
+    vector<CorpusWordCount> result;
+    result.reserve(corpus.counts.size());
+    for (uint32_t id = 0; id < corpus.counts.size(); id++) {
+        result.push_back(CorpusWordCount{string(corpus.dictionary.term(id)), corpus.counts[id]});
+    }
+    auto byFrequency = [](const CorpusWordCount& a, const CorpusWordCount& b) {
+        return a.count != b.count ? a.count > b.count : a.word < b.word;
+    };
+    const size_t kept = limit == 0 ? result.size() : min(limit, result.size());
+    partial_sort(result.begin(), result.begin() + kept, result.end(), byFrequency);
+    result.resize(kept);
+    return result;
+};
+
+auto print_corpus_word_counts = [](const TermCountShard& corpus, const size_t limit) {
+    const auto counts = corpus_word_counts(corpus, limit);
+    cout << counts.size() << " most frequent of " << corpus.counts.size() << " terms, " << corpus.total() << " tokens" << endl;
+    for (const CorpusWordCount& count : counts) {
+        cout << count.word << " " << count.count << endl;
+    }
+};
+#pragma endregion corpus statistics
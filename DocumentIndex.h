@@ -0,0 +1,218 @@
+#pragma once
+
+#include "TextAnalyzer.h"
+
+// Structure of a Gutenberg book like data/book.txt:
+//
+//   front matter    up to and including the "*** START OF" line
+//   BOOK ONE: 1805  parts, each a heading line followed by its chapters
+//   CHAPTER 1       chapters, numbered again in every part
+//   ...
+//   FIRST EPILOGUE: 1813 --20
+//   SECOND EPILOGUE
+//   back matter     from the "*** END OF" line, the license
+//
+// Offsets are into the raw text and stay valid after flatten_lines.
+#pragma region document index
+enum struct PartKind {
+    BOOK = 0,
+    EPILOGUE = 1
+};
+
+struct DocumentPart {
+    PartKind kind;
+    string title;
+    ChapterRange range;
+    size_t firstChapter;
+    size_t chapterCount;
+};
+
+struct DocumentChapter {
+    ChapterRange range;
+    size_t part;
+    int number;
+};
+
+struct DocumentIndex {
+    ChapterRange frontMatter;
+    ChapterRange backMatter;
+    vector<DocumentPart> parts;
+    vector<DocumentChapter> chapters;
+    // For the block of 2^blockShift bytes at every offset, the first chapter that ends after the
+    // block begins; see chapter_at
+    size_t blockShift = 0;
+    vector<uint32_t> blockChapters;
+};
+
+// Blocks no longer than the shortest chapter, so at most two chapters overlap a block; never below
+// 64 bytes, so a book of tiny chapters does not get a table larger than itself
+constexpr size_t minimumChapterBlockShift = 6;
+
+auto starts_with = [](const string_view text, const string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+};
+
+// "BOOK ONE: 1805", "FIRST EPILOGUE: 1813 --20" or "SECOND EPILOGUE"
+auto parse_part_heading = [](const string_view line) -> optional<PartKind> {
+    const string_view name = line.substr(0, line.find(':'));
+    if(starts_with(name, "BOOK ") && name.size() > 5){
+        return PartKind::BOOK;
+    }
+    static constexpr string_view epilogue = "EPILOGUE";
+    if(name.size() >= epilogue.size() && name.substr(name.size() - epilogue.size()) == epilogue
+       && all_of(name.begin(), name.end(), [](char c) { return isupper(static_cast<unsigned char>(c)) || c == ' '; })){
+        return PartKind::EPILOGUE;
+    }
+    return nullopt;
+};
+
+// "CHAPTER <digits>" alone on its line; returns the number and where the digits end
+auto parse_chapter_heading = [](const string_view line) -> optional<pair<int, size_t>> {
+    static constexpr string_view heading = "CHAPTER ";
+    if(!starts_with(line, heading) || line.size() == heading.size()){
+        return nullopt;
+    }
+    const string_view digits = line.substr(heading.size());
+    if(!all_of(digits.begin(), digits.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })){
+        return nullopt;
+    }
+    return make_pair(stoi(string(digits)), line.size());
+};
+
+// One pass over the line starts. Every unit ends where the next heading line begins; a chapter
+// starts right after its number, like the ranges of find_chapter_ranges.
+auto index_document = [](const string_view text) -> DocumentIndex {
+    DocumentIndex index{{0, 0}, {text.size(), text.size()}, {}, {}, 0, {}};
+
+    auto close_chapter = [&index](const size_t end) {
+        if(!index.chapters.empty() && index.chapters.back().range.end == string_view::npos){
+            index.chapters.back().range.end = end;
+        }
+    };
+    auto close_part = [&](const size_t end) {
+        close_chapter(end);
+        if(!index.parts.empty() && index.parts.back().range.end == string_view::npos){
+            index.parts.back().range.end = end;
+        }
+    };
+
+    for(size_t lineBegin = 0; lineBegin < text.size();){
+        size_t lineEnd = text.find('\n', lineBegin);
+        size_t next = lineEnd == string_view::npos ? text.size() : lineEnd + 1;
+        string_view line = text.substr(lineBegin, (lineEnd == string_view::npos ? text.size() : lineEnd) - lineBegin);
+        if(!line.empty() && line.back() == '\r'){
+            line.remove_suffix(1);
+        }
+
+        if(!line.empty()){
+            if(starts_with(line, "*** START OF")){
+                index.frontMatter.end = next;
+            }
+            else if(starts_with(line, "*** END OF")){
+                close_part(lineBegin);
+                index.backMatter.begin = lineBegin;
+                break;
+            }
+            else if(auto chapter = parse_chapter_heading(line)){
+                close_chapter(lineBegin);
+                if(index.parts.empty()){
+                    // chapters before any part heading get an untitled part
+                    index.parts.push_back(DocumentPart{PartKind::BOOK, "", {lineBegin, string_view::npos}, 0, 0});
+                }
+                index.parts.back().chapterCount++;
+                index.chapters.push_back(DocumentChapter{{lineBegin + chapter->second, string_view::npos},
+                                                         index.parts.size() - 1, chapter->first});
+            }
+            else if(auto kind = parse_part_heading(line)){
+                close_part(lineBegin);
+                index.parts.push_back(DocumentPart{kind.value(), string(line), {lineBegin, string_view::npos},
+                                                   index.chapters.size(), 0});
+            }
+        }
+        lineBegin = next;
+    }
+
+    close_part(index.backMatter.begin);
+
+    size_t shortest = text.size();
+    for(const DocumentChapter& chapter : index.chapters){
+        shortest = min(shortest, chapter.range.end - chapter.range.begin);
+    }
+    index.blockShift = minimumChapterBlockShift;
+    while((size_t{2} << index.blockShift) <= shortest){
+        index.blockShift++;
+    }
+    index.blockChapters.resize((text.size() >> index.blockShift) + 1);
+    size_t chapter = 0;
+    for(size_t block = 0; block < index.blockChapters.size(); block++){
+        while(chapter < index.chapters.size() && index.chapters[chapter].range.end <= block << index.blockShift){
+            chapter++;
+        }
+        index.blockChapters[block] = uint32_t(chapter);
+    }
+    return index;
+};
+
+// text is the indexed text from offset textBegin on, e.g. only its Gutenberg body
+auto chapter_views = [](const string_view text, const DocumentIndex& index, const size_t textBegin = 0) -> vector<string_view> {
+    vector<string_view> chapters;
+    chapters.reserve(index.chapters.size());
+    transform(index.chapters.begin(), index.chapters.end(), back_inserter(chapters), [text, textBegin](const DocumentChapter& chapter) {
+        return text.substr(chapter.range.begin - textBegin, chapter.range.end - chapter.range.begin);
+    });
+    return chapters;
+};
+
+// Index of the chapter whose range contains the offset, if any. The block of the offset names the
+// first chapter that can contain it, and at most the one after it has to be checked as well.
+auto chapter_at = [](const DocumentIndex& index, const size_t offset) -> optional<size_t> {
+    const size_t block = offset >> index.blockShift;
+    if(block >= index.blockChapters.size()){
+        return nullopt;
+    }
+    for(size_t chapter = index.blockChapters[block]; chapter < index.chapters.size() && index.chapters[chapter].range.begin <= offset; chapter++){
+        if(offset < index.chapters[chapter].range.end){
+            return chapter;
+        }
+    }
+    return nullopt;
+};
+
+struct PartSummary {
+    int warHits;
+    int peaceHits;
+    int warChapters;
+    int peaceChapters;
+};
+
+auto add_chapter_summary = [](PartSummary part, const ChapterSummary& chapter) -> PartSummary {
+    return PartSummary{part.warHits + chapter.warHits, part.peaceHits + chapter.peaceHits,
+                       part.warChapters + (chapter.relation == Relation::WAR ? 1 : 0),
+                       part.peaceChapters + (chapter.relation == Relation::PEACE ? 1 : 0)};
+};
+
+// Rolls the per-chapter summaries (in index order) up into their parts without touching the text
+auto summarize_parts = [](const DocumentIndex& index, const vector<ChapterSummary>& chapters) -> vector<PartSummary> {
+    vector<PartSummary> parts;
+    transform(index.parts.begin(), index.parts.end(), back_inserter(parts), [&chapters](const DocumentPart& part) {
+        auto first = chapters.begin() + part.firstChapter;
+        return accumulate(first, first + part.chapterCount, PartSummary{0, 0, 0, 0}, add_chapter_summary);
+    });
+    return parts;
+};
+
+auto print_structure = [](const DocumentIndex& index, const vector<ChapterSummary>& chapters) {
+    auto parts = summarize_parts(index, chapters);
+    cout << "Front matter: " << index.frontMatter.end - index.frontMatter.begin << " bytes, back matter: "
+         << index.backMatter.end - index.backMatter.begin << " bytes" << endl;
+    for(size_t p = 0; p < index.parts.size(); p++){
+        const auto& part = index.parts[p];
+        cout << (part.title.empty() ? "(untitled)" : part.title) << ": "
+             << parts[p].warChapters << " war-related, " << parts[p].peaceChapters << " peace-related chapters ("
+             << parts[p].warHits << " war terms, " << parts[p].peaceHits << " peace terms)" << endl;
+        for(size_t c = part.firstChapter; c < part.firstChapter + part.chapterCount; c++){
+            cout << "  Chapter " << index.chapters[c].number << ": " << relationToString(chapters[c].relation) << "-related" << endl;
+        }
+    }
+};
+#pragma endregion document index
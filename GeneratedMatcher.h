@@ -0,0 +1,20 @@
+#pragma once
+
+#include "TextAnalyzer.h"
+#include "CompiledLexicon.h"
+
+// Written by 'make GeneratedLexicon' into ./out, which has to be on the include path
+#include "GeneratedLexicon.h"
+
+// Same shape as filter_words, with the terms compiled into generated_category_mask
+auto generated_filter_words_into = [](const auto& words, const Relation category, auto& filterWords) {
+    copy_if(words.begin(), words.end(), back_inserter(filterWords), [category](const Word& word){
+        return (generated_category_mask(word.str.data(), word.str.size()) & category_bit(category)) != 0;
+    });
+};
+
+auto generated_filter_words = [](const vector<Word>& words, const Relation category) -> vector<Word> {
+    vector<Word> filterWords;
+    generated_filter_words_into(words, category, filterWords);
+    return filterWords;
+};
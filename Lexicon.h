@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "TextAnalyzer.h"
+
+#pragma region fuzzy matching
+// SymSpell-style index: every term is stored together with all of its single-character deletions,
+// so a token within one edit of a term shares a key with it and is found with a few hash lookups
+struct DeletionIndex {
+    vector<string> terms;
+    unordered_map<string, uint32_t> exact;
+    unordered_map<string, vector<uint32_t>> deletes;
+    size_t minFuzzyLength;
+};
+
+// Builds every distinct single-character deletion of word in deletion and calls action with it.
+// Deleting either of two equal neighbours gives the same string, so only the first is used.
+auto for_each_single_deletion = [](const string& word, string& deletion, const auto& action) {
+    for(size_t i = 0; i < word.size(); i++){
+        if(i > 0 && word[i] == word[i - 1]){
+            continue;
+        }
+        deletion.assign(word, 0, i);
+        deletion.append(word, i + 1, string::npos);
+        action(deletion);
+    }
+};
+
+auto single_deletions = [](const string& word) -> vector<string> {
+    vector<string> deletions;
+    deletions.reserve(word.size());
+    string deletion;
+    for_each_single_deletion(word, deletion, [&](const string& built){
+        deletions.push_back(built);
+    });
+    return deletions;
+};
+
+// Optimal string alignment distance <= 1: one insertion, deletion, substitution or adjacent transposition
+auto within_one_edit = [](const string& a, const string& b) -> bool {
+    const string& shorter = a.size() <= b.size() ? a : b;
+    const string& longer = a.size() <= b.size() ? b : a;
+    if(longer.size() - shorter.size() > 1){
+        return false;
+    }
+
+    auto mismatch = std::mismatch(shorter.begin(), shorter.end(), longer.begin());
+    size_t i = mismatch.first - shorter.begin();
+    if(i == shorter.size()){
+        return true;
+    }
+
+    if(shorter.size() != longer.size()){
+        return equal(shorter.begin() + i, shorter.end(), longer.begin() + i + 1);
+    }
+
+    bool substitution = equal(shorter.begin() + i + 1, shorter.end(), longer.begin() + i + 1);
+    bool transposition = i + 1 < shorter.size()
+        && shorter[i] == longer[i + 1] && shorter[i + 1] == longer[i]
+        && equal(shorter.begin() + i + 2, shorter.end(), longer.begin() + i + 2);
+    return substitution || transposition;
+};
+
+// Terms shorter than minFuzzyLength only match exactly, otherwise "war" would also match "was" and "far"
+auto build_deletion_index = [](const vector<string>& terms, size_t minFuzzyLength = 5) -> DeletionIndex {
+    DeletionIndex index{terms, {}, {}, minFuzzyLength};
+
+    for(uint32_t id = 0; id < terms.size(); id++){
+        index.exact.emplace(terms[id], id);
+        if(terms[id].size() < minFuzzyLength){
+            continue;
+        }
+
+        auto deletions = single_deletions(terms[id]);
+        for_each(deletions.begin(), deletions.end(), [&](const string& deletion){
+            index.deletes[deletion].push_back(id);
+        });
+    }
+
+    return index;
+};
+
+// Returns the id of the matching term; among several terms one edit away the one listed first wins
+auto lookup_term = [](const DeletionIndex& index, const string& token) -> optional<uint32_t> {
+    auto exactMatch = index.exact.find(token);
+    if(exactMatch != index.exact.end()){
+        return exactMatch->second;
+    }
+    if(token.size() + 1 < index.minFuzzyLength){
+        return nullopt;
+    }
+
+    optional<uint32_t> best;
+    auto consider = [&](uint32_t id){
+        if(!best.has_value() || id < best.value()){
+            best = id;
+        }
+    };
+
+    // token lacks a character of the term
+    auto missing = index.deletes.find(token);
+    if(missing != index.deletes.end()){
+        for_each(missing->second.begin(), missing->second.end(), consider);
+    }
+
+    // the deletions of every lookup on this thread are built in the same buffer
+    thread_local string deletionBuffer = []() {
+        string reserved;
+        reserved.reserve(256);
+        return reserved;
+    }();
+    for_each_single_deletion(token, deletionBuffer, [&](const string& deletion){
+        // token has one character too many
+        auto extra = index.exact.find(deletion);
+        if(extra != index.exact.end() && index.terms[extra->second].size() >= index.minFuzzyLength){
+            consider(extra->second);
+        }
+
+        // substitution or transposition, sharing a deletion with the term
+        auto shared = index.deletes.find(deletion);
+        if(shared != index.deletes.end()){
+            for_each(shared->second.begin(), shared->second.end(), [&](uint32_t id){
+                if(within_one_edit(index.terms[id], token)){
+                    consider(id);
+                }
+            });
+        }
+    });
+
+    return best;
+};
+
+// Same shape as filter_words, but the matched words carry the lexicon spelling so misspellings count towards their term
+auto fuzzy_filter_words_into = [](const auto& words, const DeletionIndex& index, auto& filterWords) {
+    for_each(words.begin(), words.end(), [&](const Word& word){
+        if(word.str.empty()){
+            return;
+        }
+        auto id = lookup_term(index, word.str);
+        if(id.has_value()){
+            filterWords.push_back(Word{index.terms[id.value()], word.indexInText});
+        }
+    });
+};
+
+auto fuzzy_filter_words = [](const vector<Word>& words, const DeletionIndex& index) -> vector<Word> {
+    vector<Word> filterWords;
+    fuzzy_filter_words_into(words, index, filterWords);
+    return filterWords;
+};
+#pragma endregion fuzzy matching
+
+#pragma region lexicon set
+// Everything the matchers need for one version of the term files
+struct LexiconSet {
+    vector<string> peaceTerms;
+    vector<string> warTerms;
+    DeletionIndex peaceIndex;
+    DeletionIndex warIndex;
+};
+
+auto build_lexicon_set = [](const vector<string>& peaceTerms, const vector<string>& warTerms) -> LexiconSet {
+    return LexiconSet{peaceTerms, warTerms, build_deletion_index(peaceTerms), build_deletion_index(warTerms)};
+};
+
+auto load_lexicon_set = [](const string& peacePath, const string& warPath) -> optional<LexiconSet> {
+    auto peaceTerms = read_terms(peacePath);
+    auto warTerms = read_terms(warPath);
+    if(!peaceTerms.has_value() || !warTerms.has_value() || peaceTerms->empty() || warTerms->empty()){
+        return nullopt;
+    }
+    return build_lexicon_set(peaceTerms.value(), warTerms.value());
+};
+#pragma endregion lexicon set
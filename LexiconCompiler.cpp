@@ -0,0 +1,38 @@
+#include "TextAnalyzer.h"
+#include "CompiledLexicon.h"
+
+// Usage: LexiconCompiler [--cpp] <peace_terms.txt> <war_terms.txt> <output>
+// Writes the binary lexicon, or with --cpp a header with a matcher specialized for the terms
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    const bool cpp = !args.empty() && args.front() == "--cpp";
+    if(cpp){
+        args.erase(args.begin());
+    }
+    if(args.size() != 3){
+        cout << "Usage: " << argv[0] << " [--cpp] <peace_terms.txt> <war_terms.txt> <output>" << endl;
+        return 1;
+    }
+
+    auto peaceTerms = read_terms(args[0]);
+    auto warTerms = read_terms(args[1]);
+    if(!peaceTerms.has_value() || !warTerms.has_value()){
+        cout << "Error reading " << args[0] << " or " << args[1] << endl;
+        return 1;
+    }
+
+    bool written;
+    if(cpp){
+        written = write_matcher_source(args[2], generate_matcher_source(peaceTerms.value(), warTerms.value()));
+    }
+    else{
+        written = write_compiled_lexicon(args[2], compile_lexicon(peaceTerms.value(), warTerms.value()));
+    }
+    if(!written){
+        cout << "Error writing " << args[2] << endl;
+        return 1;
+    }
+
+    cout << "Compiled " << peaceTerms->size() + warTerms->size() << " terms into " << args[2] << endl;
+    return 0;
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Lexicon.h"
+
+// Publishes LexiconSet versions RCU style: readers pin the current version with two atomic
+// increments and never wait, a publisher swaps the pointer and frees the old version once
+// every reader that could have seen it has released its snapshot.
+struct LexiconRegistry {
+    // Pins one version for as long as it lives, typically the analysis of one chapter
+    struct Snapshot {
+        const LexiconSet* lexicons;
+        atomic<uint64_t>* readers;
+
+        Snapshot(const LexiconSet* lexicons, atomic<uint64_t>* readers) : lexicons(lexicons), readers(readers) {}
+        Snapshot(Snapshot&& other) noexcept : lexicons(other.lexicons), readers(other.readers) {
+            other.readers = nullptr;
+        }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot() {
+            if(readers != nullptr){
+                readers->fetch_sub(1);
+            }
+        }
+
+        const LexiconSet& operator*() const { return *lexicons; }
+        const LexiconSet* operator->() const { return lexicons; }
+    };
+
+    explicit LexiconRegistry(LexiconSet initial) : current(new LexiconSet(std::move(initial))) {}
+    LexiconRegistry(const LexiconRegistry&) = delete;
+    LexiconRegistry& operator=(const LexiconRegistry&) = delete;
+    ~LexiconRegistry() {
+        delete current.load();
+    }
+
+    // Readers count themselves in the half of the epoch they entered; if the epoch flips before
+    // the count is visible they retry, so a publisher waiting on that half always sees them
+    Snapshot acquire() {
+        while(true){
+            uint64_t entered = epoch.load();
+            readers[entered & 1].fetch_add(1);
+            if(epoch.load() == entered){
+                return Snapshot(current.load(), &readers[entered & 1]);
+            }
+            readers[entered & 1].fetch_sub(1);
+        }
+    }
+
+    // Blocks only the publisher until the readers of the previous version are done
+    void publish(LexiconSet next) {
+        lock_guard<mutex> lock(publishing);
+        const LexiconSet* previous = current.exchange(new LexiconSet(std::move(next)));
+        uint64_t retiring = epoch.fetch_add(1);
+        while(readers[retiring & 1].load() != 0){
+            this_thread::yield();
+        }
+        delete previous;
+        versionCount.fetch_add(1);
+    }
+
+    uint64_t version() const {
+        return versionCount.load();
+    }
+
+    atomic<const LexiconSet*> current;
+    atomic<uint64_t> epoch{0};
+    atomic<uint64_t> readers[2] = {{0}, {0}};
+    atomic<uint64_t> versionCount{1};
+    mutex publishing;
+};
+
+// Background thread that rebuilds the lexicons whenever one of the term files changes and
+// publishes the result; a file that fails to load keeps the previous version in place
+struct LexiconWatcher {
+    LexiconWatcher(LexiconRegistry& registry, string peacePath, string warPath)
+        : registry(registry), peacePath(std::move(peacePath)), warPath(std::move(warPath)) {
+        worker = thread([this]() { watch(); });
+    }
+    LexiconWatcher(const LexiconWatcher&) = delete;
+    LexiconWatcher& operator=(const LexiconWatcher&) = delete;
+    ~LexiconWatcher() {
+        stopping = true;
+        worker.join();
+    }
+
+    void reload() {
+        auto lexicons = load_lexicon_set(peacePath, warPath);
+        if(lexicons.has_value()){
+            registry.publish(std::move(lexicons.value()));
+        }
+    }
+
+#ifdef __linux__
+    // Watches the directories rather than the files, editors often replace a file by renaming over it
+    void watch() {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(fd < 0){
+            return watch_by_polling();
+        }
+
+        const auto peaceName = filesystem::path(peacePath).filename().string();
+        const auto warName = filesystem::path(warPath).filename().string();
+        auto directoryOf = [](const string& path) {
+            auto directory = filesystem::path(path).parent_path();
+            return directory.empty() ? string(".") : directory.string();
+        };
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+        inotify_add_watch(fd, directoryOf(peacePath).c_str(), mask);
+        inotify_add_watch(fd, directoryOf(warPath).c_str(), mask);
+
+        alignas(inotify_event) char buffer[4096];
+        pollfd pending{fd, POLLIN, 0};
+        while(!stopping){
+            if(poll(&pending, 1, 100) <= 0){
+                continue;
+            }
+
+            bool changed = false;
+            ssize_t length;
+            while((length = read(fd, buffer, sizeof(buffer))) > 0){
+                for(char* next = buffer; next < buffer + length;){
+                    auto event = reinterpret_cast<const inotify_event*>(next);
+                    if(event->len > 0 && (peaceName == event->name || warName == event->name)){
+                        changed = true;
+                    }
+                    next += sizeof(inotify_event) + event->len;
+                }
+            }
+            if(changed){
+                reload();
+            }
+        }
+        close(fd);
+    }
+#else
+    void watch() {
+        watch_by_polling();
+    }
+#endif
+
+    void watch_by_polling() {
+        auto modified = [this]() {
+            error_code ignored;
+            return make_pair(filesystem::last_write_time(peacePath, ignored), filesystem::last_write_time(warPath, ignored));
+        };
+        auto seen = modified();
+        while(!stopping){
+            this_thread::sleep_for(chrono::milliseconds(250));
+            auto now = modified();
+            if(now != seen){
+                seen = now;
+                reload();
+            }
+        }
+    }
+
+    LexiconRegistry& registry;
+    const string peacePath;
+    const string warPath;
+    atomic<bool> stopping{false};
+    thread worker;
+};
+
+// Every chapter pins the version that is current when it starts, so a reload never changes the
+// terms in the middle of a chapter and the old version is freed after its last chapter is done
+auto process_all_chapters_live = [](const auto& chapters, LexiconRegistry& registry, const bool fuzzy) -> map<int, Relation> {
+    map<int, Relation> chapter_densities;
+    int chapter_number = 1;
+    for_each(chapters.begin(), chapters.end(), [&](const string_view chapter) {
+        auto lexicons = registry.acquire();
+        if(fuzzy){
+            auto filterPeaceTerms = bind(fuzzy_filter_words, _1, cref(lexicons->peaceIndex));
+            auto filterWarTerms = bind(fuzzy_filter_words, _1, cref(lexicons->warIndex));
+            chapter_densities[chapter_number++] = process_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+        }
+        else{
+            auto filterPeaceTerms = bind(filter_words, _1, cref(lexicons->peaceTerms));
+            auto filterWarTerms = bind(filter_words, _1, cref(lexicons->warTerms));
+            chapter_densities[chapter_number++] = process_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+        }
+    });
+    return chapter_densities;
+};
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Placement.h"
+
+// Chapters summarized by forked worker processes instead of threads. Each worker has its own heap,
+// so workers share no allocator, and a worker that crashes takes none of the others with it. The
+// chapters reach the workers through the copy-on-write memory of the fork. The summaries come back
+// through one ring per worker in memory shared with memfd and mmap. The coordinator places them by
+// chapter, so they come out in chapter order. It summarizes itself whatever a failed worker did
+// not deliver.
+#pragma region shared memory
+// An anonymous file mapped shared, so processes forked after it was mapped share it
+class SharedMemory {
+public:
+    explicit SharedMemory(const size_t bytes) : bytes(bytes) {
+        const int fd = memfd_create("chapter-results", MFD_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if (ftruncate(fd, off_t(bytes)) == 0) {
+            void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : mapped;
+        }
+        // the mapping keeps the file alive
+        close(fd);
+    }
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    ~SharedMemory() {
+        if (data != nullptr) {
+            munmap(data, bytes);
+        }
+    }
+
+    bool valid() const {
+        return data != nullptr;
+    }
+
+    byte* get() const {
+        return static_cast<byte*>(data);
+    }
+
+private:
+    size_t bytes;
+    void* data = nullptr;
+};
+
+// How a process waits for another one: a few yields, then sleeps that double up to a millisecond.
+// The processes share no condition variable, and a worker that crashed would never wake the
+// coordinator anyway, so the waiting side polls, but rarely.
+class ProcessBackoff {
+public:
+    void pause() {
+        if (yields < processYields) {
+            yields++;
+            this_thread::yield();
+            return;
+        }
+        this_thread::sleep_for(sleep);
+        sleep = min(sleep * 2, longestSleep);
+    }
+
+    // after the other side made progress
+    void reset() {
+        yields = 0;
+        sleep = shortestSleep;
+    }
+
+private:
+    static constexpr size_t processYields = 64;
+    static constexpr chrono::microseconds shortestSleep{10};
+    static constexpr chrono::microseconds longestSleep{1000};
+    size_t yields = 0;
+    chrono::microseconds sleep = shortestSleep;
+};
+
+// The summary of chapters[chapter]
+struct ChapterRecord {
+    uint32_t chapter;
+    ChapterSummary summary;
+};
+static_assert(is_trivially_copyable_v<ChapterRecord>, "records are copied between processes byte by byte");
+
+// The indices at the start of a ring's part of the shared memory, the slots follow them
+struct SharedRingHeader {
+    alignas(cacheLineSize) atomic<uint64_t> head{0};
+    alignas(cacheLineSize) atomic<uint64_t> tail{0};
+};
+static_assert(atomic<uint64_t>::is_always_lock_free, "the ring indices are shared between processes");
+
+// SpscRing over shared memory, for one producer and one consumer process. The indices and records
+// live in the shared memory; every process has its own copy of this object and of the cached index.
+// A producer that dies between writing a record and publishing it has not published it.
+class SharedResultRing {
+public:
+    static size_t bytes_for(const size_t capacity) {
+        const size_t bytes = sizeof(SharedRingHeader) + capacity * sizeof(ChapterRecord);
+        return (bytes + cacheLineSize - 1) / cacheLineSize * cacheLineSize;
+    }
+
+    // memory has bytes_for(capacity) bytes; capacity is a power of two
+    SharedResultRing(byte* memory, const size_t capacity)
+        : header(new (memory) SharedRingHeader), slots(reinterpret_cast<ChapterRecord*>(memory + sizeof(SharedRingHeader))), capacity(capacity) {}
+
+    // Producer only
+    bool try_push(const ChapterRecord& record) {
+        const uint64_t t = header->tail.load(memory_order_relaxed);
+        if (t - cachedHead == capacity) {
+            cachedHead = header->head.load(memory_order_acquire);
+            if (t - cachedHead == capacity) {
+                return false;
+            }
+        }
+        slots[t & (capacity - 1)] = record;
+        header->tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    // Producer only; waits while the ring is full
+    void push(const ChapterRecord& record) {
+        ProcessBackoff backoff;
+        while (!try_push(record)) {
+            backoff.pause();
+        }
+    }
+
+    // Consumer only
+    bool try_pop(ChapterRecord& record) {
+        const uint64_t h = header->head.load(memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = header->tail.load(memory_order_acquire);
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        record = slots[h & (capacity - 1)];
+        header->head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+private:
+    SharedRingHeader* header;
+    ChapterRecord* slots;
+    size_t capacity;
+    uint64_t cachedHead = 0;
+    uint64_t cachedTail = 0;
+};
+#pragma endregion shared memory
+
+#pragma region worker processes
+constexpr size_t processRingSlots = 256;
+
+struct ProcessStats {
+    size_t workers = 0;
+    // crashed, exited with an error or could not be forked
+    size_t failed = 0;
+    // chapters the coordinator summarized because their worker failed
+    size_t recovered = 0;
+    double milliseconds = 0;
+};
+
+struct ProcessRun {
+    vector<ChapterSummary> summaries;
+    ProcessStats stats;
+};
+
+// workerCount processes get consecutive chapters with about the same number of bytes each. nullopt
+// if there is no shared memory for the rings. The filters run in the workers, and in the
+// coordinator for recovered chapters.
+auto summarize_all_chapters_forked = [](const auto& chapters, const size_t workerCount) {
+    return [&chapters, workerCount](const auto& filterPeaceTerms, const auto& filterWarTerms) -> optional<ProcessRun> {
+        const auto started = chrono::steady_clock::now();
+        const size_t processCount = max<size_t>(min(workerCount, chapters.size()), 1);
+        const size_t capacity = ring_capacity(processRingSlots);
+        const size_t ringBytes = SharedResultRing::bytes_for(capacity);
+        SharedMemory memory(ringBytes * processCount);
+        if (!memory.valid()) {
+            return nullopt;
+        }
+        vector<SharedResultRing> rings;
+        for (size_t k = 0; k < processCount; k++) {
+            rings.emplace_back(memory.get() + k * ringBytes, capacity);
+        }
+
+        const auto ranges = split_chapters_by_bytes(chapters, processCount);
+        const pid_t coordinator = getpid();
+        // 0 once the worker has been reaped, -1 if it could not be forked
+        vector<pid_t> workers(processCount);
+        ProcessRun run{vector<ChapterSummary>(chapters.size()), ProcessStats{processCount, 0, 0, 0}};
+        for (size_t k = 0; k < processCount; k++) {
+            workers[k] = fork();
+            if (workers[k] == 0) {
+                // a worker must not outlive the coordinator that empties its ring
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                if (getppid() != coordinator) {
+                    _exit(1);
+                }
+                for (size_t i = ranges[k].first; i < ranges[k].second; i++) {
+                    rings[k].push(ChapterRecord{uint32_t(i), summarize_chapter(chapters[i])(filterPeaceTerms, filterWarTerms)});
+                }
+                // no destructors and no flushing of the coordinator's buffers
+                _exit(0);
+            }
+            if (workers[k] < 0) {
+                run.stats.failed++;
+            }
+        }
+
+        vector<bool> received(chapters.size(), false);
+        auto drain = [&](const size_t k) -> bool {
+            bool any = false;
+            ChapterRecord record;
+            while (rings[k].try_pop(record)) {
+                if (record.chapter < chapters.size()) {
+                    run.summaries[record.chapter] = record.summary;
+                    received[record.chapter] = true;
+                }
+                any = true;
+            }
+            return any;
+        };
+        size_t running = count_if(workers.begin(), workers.end(), [](const pid_t pid) { return pid > 0; });
+        ProcessBackoff backoff;
+        while (running > 0) {
+            bool progress = false;
+            for (size_t k = 0; k < processCount; k++) {
+                progress = drain(k) || progress;
+            }
+            if (progress) {
+                backoff.reset();
+                continue;
+            }
+            for (size_t k = 0; k < processCount; k++) {
+                int status = 0;
+                if (workers[k] > 0 && waitpid(workers[k], &status, WNOHANG) == workers[k]) {
+                    // what it published before it exited
+                    drain(k);
+                    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        run.stats.failed++;
+                    }
+                    workers[k] = 0;
+                    running--;
+                }
+            }
+            backoff.pause();
+        }
+
+        for (size_t i = 0; i < chapters.size(); i++) {
+            if (!received[i]) {
+                run.summaries[i] = summarize_chapter(chapters[i])(filterPeaceTerms, filterWarTerms);
+                run.stats.recovered++;
+            }
+        }
+        run.stats.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        return run;
+    };
+};
+
+auto print_process_stats = [](ostream& out, const ProcessStats& stats) {
+    out << stats.workers << " worker processes, " << stats.failed << " failed, " << stats.recovered
+        << " chapters recovered by the coordinator, " << stats.milliseconds << " ms" << endl;
+};
+#pragma endregion worker processes
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef USE_PARALLEL_STL
+#include <execution>
+#endif
+
+#include "ThreadPool.h"
+
+// The chapter-level algorithm calls with a parallel backend. Built with USE_PARALLEL_STL (needs TBB,
+// see PARALLEL_STL_FLAGS in the makefile) they are the std algorithms with execution::par, otherwise
+// they run on a pool of one thread per hardware thread that the process shares.
+// Chapters use the arena of the thread they run on, so two chapters must not be interleaved on one
+// thread as par_unseq would allow; par is the strongest policy they can run under.
+#pragma region parallel algorithms
+auto shared_pool = []() -> ThreadPool& {
+    static ThreadPool pool(default_thread_count());
+    return pool;
+};
+
+auto parallel_backend = []() -> string {
+#ifdef USE_PARALLEL_STL
+    return "execution::par";
+#else
+    return "shared pool";
+#endif
+};
+
+// Same as transform into output, which has room for every result. op runs on several threads at
+// once and may only write to its own result. Not to be called from a task of the shared pool.
+template <typename Input, typename Output, typename Operation>
+void parallel_transform(const Input& input, Output& output, const Operation& op) {
+#ifdef USE_PARALLEL_STL
+    transform(execution::par, input.begin(), input.end(), output.begin(), op);
+#else
+    ThreadPool& pool = shared_pool();
+    const size_t count = input.size();
+    atomic<size_t> next{0};
+    for (size_t worker = 0; worker < min(pool.size(), count); worker++) {
+        pool.submit([&]() {
+            for (size_t i = next++; i < count; i = next++) {
+                output[i] = op(input[i]);
+            }
+        });
+    }
+    pool.wait();
+#endif
+}
+
+// process_all_chapters with the chapters transformed by parallel_transform
+auto process_all_chapters_parallel_stl = [](const auto& chapters) {
+    return [&chapters](const auto& filterPeaceTerms, const auto& filterWarTerms) -> map<int, Relation> {
+        vector<Relation> relations(chapters.size());
+        parallel_transform(chapters, relations, [&](const string_view chapter) {
+            return process_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+        });
+        return number_chapters(relations);
+    };
+};
+#pragma endregion parallel algorithms
@@ -0,0 +1,631 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ThreadPool.h"
+
+// Reading, chapter splitting and scoring as stages that run at the same time: a reader thread reads
+// the book in blocks, a boundary detector cuts chapters out of them as soon as the next heading has
+// been read, workers summarize the chapters and the calling thread prints them in chapter order.
+// The stages are connected by bounded rings, a full ring makes the stage before it wait.
+#pragma region ring buffers
+auto ring_capacity = [](const size_t minimum) -> size_t {
+    size_t capacity = 2;
+    while (capacity < minimum) {
+        capacity *= 2;
+    }
+    return capacity;
+};
+
+// How often a side of a ring retries before it goes to sleep. A chapter takes long enough to
+// summarize that a ring which stays full or empty for this long stays so for a while.
+constexpr size_t ringSpins = 64;
+
+// Where one side of a ring sleeps until the other side has moved its index. wake_one and wake_all
+// only cost a fence and a load while nobody sleeps.
+class RingSleeper {
+public:
+    // Returns once attempt(), which must not block, succeeds. Retries a few times before sleeping.
+    template <typename Attempt>
+    void wait_until(const Attempt& attempt) {
+        for (size_t spin = 0; spin < ringSpins; spin++) {
+            if (attempt()) {
+                return;
+            }
+            this_thread::yield();
+        }
+        unique_lock<mutex> lock(guard);
+        sleepers.fetch_add(1, memory_order_relaxed);
+        // pairs with the fence in wake: either wake sees this sleeper, or attempt sees the index
+        // the other side moved before it called wake
+        atomic_thread_fence(memory_order_seq_cst);
+        wakeup.wait(lock, attempt);
+        sleepers.fetch_sub(1, memory_order_relaxed);
+    }
+
+    void wake_one() {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleepers.load(memory_order_relaxed) > 0) {
+            lock_guard<mutex> lock(guard);
+            wakeup.notify_one();
+        }
+    }
+
+    void wake_all() {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sleepers.load(memory_order_relaxed) > 0) {
+            lock_guard<mutex> lock(guard);
+            wakeup.notify_all();
+        }
+    }
+
+private:
+    mutex guard;
+    condition_variable wakeup;
+    atomic<size_t> sleepers{0};
+};
+
+// One producer and one consumer thread. Each side keeps a copy of the other side's index and only
+// reloads it when the ring looks full or empty. push and pop sleep on a full or empty ring and wake
+// the other side; try_push and try_pop do neither, so a ring uses one pair or the other.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(const size_t minimumCapacity) : capacity(ring_capacity(minimumCapacity)), slots(new T[capacity]) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer only
+    bool try_push(T& value) {
+        const size_t t = tail.load(memory_order_relaxed);
+        if (t - cachedHead == capacity) {
+            cachedHead = head.load(memory_order_acquire);
+            if (t - cachedHead == capacity) {
+                return false;
+            }
+        }
+        slots[t & (capacity - 1)] = std::move(value);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    // Producer only; waits while the ring is full
+    void push(T value) {
+        if (!try_push(value)) {
+            fullWaits++;
+            notFull.wait_until([&]() { return try_push(value); });
+        }
+        notEmpty.wake_one();
+    }
+
+    // Producer only; pop returns false once the ring is closed and empty
+    void close() {
+        closed.store(true, memory_order_release);
+        notEmpty.wake_all();
+    }
+
+    // Consumer only
+    bool try_pop(T& value) {
+        const size_t h = head.load(memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(memory_order_acquire);
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        value = std::move(slots[h & (capacity - 1)]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer only; waits while the ring is empty and open
+    bool pop(T& value) {
+        bool popped = false;
+        notEmpty.wait_until([&]() {
+            popped = try_pop(value);
+            return popped || closed.load(memory_order_acquire);
+        });
+        // a value pushed before close may have arrived after the attempt
+        if (!popped && !try_pop(value)) {
+            return false;
+        }
+        notFull.wake_one();
+        return true;
+    }
+
+    // Times push found the ring full, read by the producer or after it finished
+    size_t full_waits() const {
+        return fullWaits;
+    }
+
+private:
+    const size_t capacity;
+    unique_ptr<T[]> slots;
+    alignas(cacheLineSize) atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(cacheLineSize) atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+    size_t fullWaits = 0;
+    alignas(cacheLineSize) atomic<bool> closed{false};
+    RingSleeper notFull;
+    RingSleeper notEmpty;
+};
+
+// Any number of producers and consumers, Vyukov's bounded queue: every slot has a sequence number
+// that tells whether it is free for the push at that index or holds the value for the pop at it
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(const size_t minimumCapacity) : capacity(ring_capacity(minimumCapacity)), slots(new Slot[capacity]) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    bool try_push(T& value) {
+        size_t position = tail.load(memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & (capacity - 1)];
+            const auto difference = intptr_t(slot->sequence.load(memory_order_acquire)) - intptr_t(position);
+            if (difference == 0 && tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                break;
+            }
+            if (difference < 0) {
+                return false;
+            }
+            if (difference > 0) {
+                position = tail.load(memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    void push(T value) {
+        if (!try_push(value)) {
+            fullWaits.fetch_add(1, memory_order_relaxed);
+            notFull.wait_until([&]() { return try_push(value); });
+        }
+        notEmpty.wake_one();
+    }
+
+    // Called once every producer is done
+    void close() {
+        closed.store(true, memory_order_release);
+        notEmpty.wake_all();
+    }
+
+    bool try_pop(T& value) {
+        size_t position = head.load(memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & (capacity - 1)];
+            const auto difference = intptr_t(slot->sequence.load(memory_order_acquire)) - intptr_t(position + 1);
+            if (difference == 0 && head.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                break;
+            }
+            if (difference < 0) {
+                return false;
+            }
+            if (difference > 0) {
+                position = head.load(memory_order_relaxed);
+            }
+        }
+        value = std::move(slot->value);
+        slot->sequence.store(position + capacity, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        bool popped = false;
+        notEmpty.wait_until([&]() {
+            popped = try_pop(value);
+            return popped || closed.load(memory_order_acquire);
+        });
+        if (!popped && !try_pop(value)) {
+            return false;
+        }
+        notFull.wake_one();
+        return true;
+    }
+
+    size_t full_waits() const {
+        return fullWaits.load(memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t capacity;
+    unique_ptr<Slot[]> slots;
+    alignas(cacheLineSize) atomic<size_t> head{0};
+    alignas(cacheLineSize) atomic<size_t> tail{0};
+    alignas(cacheLineSize) atomic<size_t> fullWaits{0};
+    atomic<bool> closed{false};
+    RingSleeper notFull;
+    RingSleeper notEmpty;
+};
+#pragma endregion ring buffers
+
+#pragma region reorder buffer
+// Hands results that are finished in any order to the writer in index order, each one as soon as
+// every index before it has been written. At most window results wait ahead of the writer: whoever
+// schedules index i first calls wait_for_room(i), which blocks while i is window or more past the
+// next index to write. The writer runs on the thread that filled the gap, under the buffer's lock,
+// so writes never overlap.
+template <typename T>
+class ReorderBuffer {
+public:
+    ReorderBuffer(const size_t window, function<void(size_t, T&)> writer) : slots(max<size_t>(window, 1)), writer(std::move(writer)) {}
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    void wait_for_room(const size_t index) {
+        unique_lock<mutex> lock(guard);
+        if (index >= next + slots.size()) {
+            roomWaits++;
+            room.wait(lock, [&]() { return index < next + slots.size(); });
+        }
+    }
+
+    // Only for an index that had room
+    void complete(const size_t index, T value) {
+        lock_guard<mutex> lock(guard);
+        slots[index % slots.size()] = std::move(value);
+        peak = max(peak, ++buffered);
+        const size_t before = next;
+        for (optional<T>* slot = &slots[next % slots.size()]; slot->has_value(); slot = &slots[next % slots.size()]) {
+            writer(next, slot->value());
+            slot->reset();
+            buffered--;
+            next++;
+        }
+        if (next != before) {
+            room.notify_all();
+        }
+    }
+
+    size_t written() const {
+        lock_guard<mutex> lock(guard);
+        return next;
+    }
+
+    // Times wait_for_room had to block
+    size_t room_waits() const {
+        lock_guard<mutex> lock(guard);
+        return roomWaits;
+    }
+
+    // Most results that were buffered at once, the one being completed included
+    size_t peak_buffered() const {
+        lock_guard<mutex> lock(guard);
+        return peak;
+    }
+
+private:
+    vector<optional<T>> slots;
+    function<void(size_t, T&)> writer;
+    mutable mutex guard;
+    condition_variable room;
+    size_t next = 0;
+    size_t buffered = 0;
+    size_t peak = 0;
+    size_t roomWaits = 0;
+};
+
+constexpr size_t defaultReorderWindow = 64;
+
+struct ReorderStats {
+    size_t chapters = 0;
+    size_t roomWaits = 0;
+    size_t peakBuffered = 0;
+};
+
+// summarize_all_chapters_parallel, but instead of returning the summaries it calls emit with the
+// number and summary of every chapter in chapter order as soon as all chapters before it are done.
+// emit runs on the workers, one call at a time. A worker does not start a chapter that is window or
+// more ahead of the next one to emit.
+auto stream_all_chapters_parallel = [](const auto& chapters, ThreadPool& pool, const size_t window, const auto& emit) {
+    return [&chapters, &pool, window, &emit](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ReorderStats {
+        ReorderBuffer<ChapterSummary> reorder(window, [&emit](const size_t index, ChapterSummary& summary) { emit(int(index + 1), summary); });
+        atomic<size_t> next{0};
+        for (size_t worker = 0; worker < min(pool.size(), chapters.size()); worker++) {
+            pool.submit([&]() {
+                for (size_t i = next++; i < chapters.size(); i = next++) {
+                    reorder.wait_for_room(i);
+                    reorder.complete(i, summarize_chapter(chapters[i])(filterPeaceTerms, filterWarTerms));
+                }
+            });
+        }
+        pool.wait();
+        return ReorderStats{reorder.written(), reorder.room_waits(), reorder.peak_buffered()};
+    };
+};
+#pragma endregion reorder buffer
+
+#pragma region chapter pipeline
+// Finds the chapters of raw text that arrives in blocks, with the same result as cutting the
+// Gutenberg body out of the whole text, flattening it and splitting it at "CHAPTER <digits>".
+// A chapter is handed on once the heading after it has been read. The body ends at the last
+// "*** END OF" marker, so everything from the first one on is only split when the text is complete.
+// The "*** START OF" marker is only looked for in the first startLookAhead bytes; without one there
+// the body starts at the beginning, so a book without the marker is not held back until its end.
+class ChapterBoundaryDetector {
+public:
+    template <typename Emit>
+    void feed(const string_view block, Emit&& emit) {
+        pending.append(block);
+        if (!bodyFound && !find_body_start(false)) {
+            return;
+        }
+        find_first_end();
+        scan_headings(firstEnd.value_or(pending.size()), false, emit);
+        compact();
+    }
+
+    template <typename Emit>
+    void finish(Emit&& emit) {
+        if (!bodyFound) {
+            find_body_start(true);
+        }
+        const size_t end = pending.rfind(endMarker);
+        if (end != string::npos) {
+            pending.resize(end);
+        }
+        scan_headings(pending.size(), true, emit);
+        if (chapterBegin.has_value() && chapterBegin.value() < pending.size()) {
+            emit(flatten_lines(pending.substr(chapterBegin.value())));
+        }
+        pending.clear();
+        chapterBegin.reset();
+    }
+
+private:
+    static constexpr string_view startMarker = "*** START OF";
+    static constexpr string_view endMarker = "*** END OF";
+    static constexpr string_view heading = "CHAPTER ";
+    // Far more than a Gutenberg header takes
+    static constexpr size_t startLookAhead = 64 * 1024;
+
+    // Same rule as find_gutenberg_body; without the end of the marker line it waits for more text.
+    // Nothing is handed on before the body is found, so pending still holds the text from its start.
+    bool find_body_start(const bool final) {
+        const size_t start = pending.find(startMarker, startScanned);
+        if (start == string::npos || start >= startLookAhead) {
+            // a marker that begins inside the look-ahead may still be cut off at the end of pending
+            if (!final && pending.size() < startLookAhead + startMarker.size()) {
+                startScanned = max(pending.size(), startMarker.size()) - startMarker.size();
+                return false;
+            }
+            bodyFound = true;
+            return true;
+        }
+        const size_t lineEnd = pending.find('\n', start);
+        if (lineEnd == string::npos && !final) {
+            startScanned = start;
+            return false;
+        }
+        const size_t closing = pending.find("***", start + 3);
+        const size_t begin = closing != string::npos && closing < lineEnd ? closing + 3
+                           : lineEnd == string::npos ? pending.size() : lineEnd + 1;
+        pending.erase(0, begin);
+        bodyFound = true;
+        return true;
+    }
+
+    void find_first_end() {
+        if (firstEnd.has_value()) {
+            return;
+        }
+        const size_t end = pending.find(endMarker, endScanned);
+        if (end != string::npos) {
+            firstEnd = end;
+        }
+        else {
+            endScanned = max(pending.size(), endMarker.size()) - endMarker.size();
+        }
+    }
+
+    // Headings in the flattened text, where line breaks are spaces
+    bool is_heading_at(const size_t at) const {
+        return equal(heading.begin(), heading.end(), pending.begin() + at, [](const char expected, const char c) {
+            return (c == '\n' ? ' ' : c) == expected;
+        });
+    }
+
+    // As find_chapter_ranges up to limit; unless final, a heading whose digits may continue after limit waits
+    template <typename Emit>
+    void scan_headings(const size_t limit, const bool final, Emit& emit) {
+        while (scanned < limit) {
+            const void* candidate = memchr(pending.data() + scanned, 'C', limit - scanned);
+            if (candidate == nullptr) {
+                scanned = limit;
+                break;
+            }
+            const size_t at = static_cast<const char*>(candidate) - pending.data();
+            size_t digits = at + heading.size();
+            if (digits >= limit && !final) {
+                scanned = at;
+                break;
+            }
+            if (digits >= limit || !is_heading_at(at) || !isdigit(static_cast<unsigned char>(pending[digits]))) {
+                scanned = at + 1;
+                continue;
+            }
+
+            while (digits < limit && isdigit(static_cast<unsigned char>(pending[digits]))) {
+                digits++;
+            }
+            if (digits == limit && !final) {
+                scanned = at;
+                break;
+            }
+            if (chapterBegin.has_value()) {
+                emit(flatten_lines(pending.substr(chapterBegin.value(), at - chapterBegin.value())));
+            }
+            chapterBegin = digits;
+            scanned = digits;
+        }
+    }
+
+    // Drops the text that was handed on or lies before the first heading
+    void compact() {
+        size_t keep = chapterBegin.value_or(scanned);
+        if (!firstEnd.has_value()) {
+            keep = min(keep, endScanned);
+        }
+        pending.erase(0, keep);
+        scanned -= keep;
+        endScanned -= min(endScanned, keep);
+        if (chapterBegin.has_value()) {
+            chapterBegin = chapterBegin.value() - keep;
+        }
+        if (firstEnd.has_value()) {
+            firstEnd = firstEnd.value() - keep;
+        }
+    }
+
+    string pending;
+    bool bodyFound = false;
+    size_t startScanned = 0;
+    size_t endScanned = 0;
+    size_t scanned = 0;
+    optional<size_t> chapterBegin;
+    optional<size_t> firstEnd;
+};
+
+struct ChapterTask {
+    int number = 0;
+    string text;
+};
+
+struct ChapterResult {
+    int number = 0;
+    ChapterSummary summary;
+};
+
+struct PipelineStats {
+    size_t chapters = 0;
+    size_t bytesRead = 0;
+    double firstChapterMilliseconds = 0;
+    double totalMilliseconds = 0;
+    size_t readerWaits = 0;
+    size_t detectorWaits = 0;
+    size_t workerWaits = 0;
+    size_t reorderWaits = 0;
+    size_t peakReordered = 0;
+};
+
+constexpr size_t pipelineBlockSize = 64 * 1024;
+
+// Runs the stages on the book at bookPath with workerCount summarizing threads and calls emit with
+// the number and summary of every chapter in chapter order, on the calling thread; nullopt if the
+// book cannot be read. The detector does not hand on a chapter that is window or more ahead of the
+// next one to emit.
+auto stream_chapters = [](const string& bookPath, const size_t workerCount, const size_t window, const auto& emit) {
+    return [&bookPath, workerCount, window, &emit](const auto& filterPeaceTerms, const auto& filterWarTerms) -> optional<PipelineStats> {
+        ifstream input(bookPath, ios::binary);
+        if (!input.is_open()) {
+            return nullopt;
+        }
+
+        const auto started = chrono::steady_clock::now();
+        const size_t workers = max<size_t>(workerCount, 1);
+        SpscRing<string> blocks(16);
+        MpmcRing<ChapterTask> tasks(2 * workers);
+        MpmcRing<ChapterResult> results(2 * workers);
+        PipelineStats stats;
+        ReorderBuffer<ChapterSummary> reorder(window, [&](const size_t index, ChapterSummary& summary) {
+            if (index == 0) {
+                stats.firstChapterMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            }
+            emit(int(index + 1), summary);
+        });
+
+        thread reader([&]() {
+            while (true) {
+                string block(pipelineBlockSize, '\0');
+                input.read(block.data(), streamsize(block.size()));
+                block.resize(size_t(input.gcount()));
+                if (block.empty()) {
+                    break;
+                }
+                stats.bytesRead += block.size();
+                blocks.push(std::move(block));
+            }
+            blocks.close();
+        });
+
+        thread detector([&]() {
+            ChapterBoundaryDetector chapters;
+            int number = 0;
+            auto hand_on = [&](string chapter) {
+                reorder.wait_for_room(size_t(number));
+                tasks.push(ChapterTask{++number, std::move(chapter)});
+            };
+            string block;
+            while (blocks.pop(block)) {
+                chapters.feed(block, hand_on);
+            }
+            chapters.finish(hand_on);
+            tasks.close();
+        });
+
+        atomic<size_t> running{workers};
+        vector<thread> summarizers;
+        for (size_t i = 0; i < workers; i++) {
+            summarizers.emplace_back([&]() {
+                ChapterTask task;
+                while (tasks.pop(task)) {
+                    results.push(ChapterResult{task.number, summarize_chapter(task.text)(filterPeaceTerms, filterWarTerms)});
+                }
+                if (running.fetch_sub(1, memory_order_acq_rel) == 1) {
+                    results.close();
+                }
+            });
+        }
+
+        // results arrive in any order; the ones that are ahead wait until the gap before them is filled
+        ChapterResult result;
+        while (results.pop(result)) {
+            reorder.complete(size_t(result.number - 1), result.summary);
+        }
+
+        reader.join();
+        detector.join();
+        for (thread& summarizer : summarizers) {
+            summarizer.join();
+        }
+        stats.chapters = reorder.written();
+        stats.readerWaits = blocks.full_waits();
+        stats.detectorWaits = tasks.full_waits();
+        stats.workerWaits = results.full_waits();
+        stats.reorderWaits = reorder.room_waits();
+        stats.peakReordered = reorder.peak_buffered();
+        stats.totalMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        return stats;
+    };
+};
+
+auto print_pipeline_stats = [](ostream& out, const PipelineStats& stats) {
+    out << stats.chapters << " chapters from " << stats.bytesRead << " bytes, first after " << stats.firstChapterMilliseconds
+        << " ms, all after " << stats.totalMilliseconds << " ms; waits on full rings: reader " << stats.readerWaits
+        << ", detector " << stats.detectorWaits << ", workers " << stats.workerWaits << "; detector waited for the reorder window "
+        << stats.reorderWaits << " times, at most " << stats.peakReordered << " chapters buffered" << endl;
+};
+#pragma endregion chapter pipeline
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "ThreadPool.h"
+
+// Where workers run and where their memory lives. The NUMA nodes and their CPUs come from sysfs,
+// restricted to the CPUs the process may run on. Memory is placed by first touch: Linux puts a page
+// on the node of the thread that first writes it, so a buffer filled by a thread pinned to a node
+// stays on that node. The chapter arena is created by the first chapter a thread runs, so a worker
+// that is pinned before it gets its arena on its own node as well.
+#pragma region placement
+struct NumaNode {
+    int id;
+    vector<int> cpus;
+};
+
+// "0-3,8,10-11" as in sysfs and cpuset; empty for anything else
+auto parse_cpu_list = [](const string_view list) -> vector<int> {
+    vector<int> cpus;
+    size_t start = 0;
+    while (start < list.size() && list[start] != '\n') {
+        size_t end = list.find_first_of(",\n", start);
+        if (end == string_view::npos) {
+            end = list.size();
+        }
+        const string_view range = list.substr(start, end - start);
+        const size_t dash = range.find('-');
+        auto number = [](const string_view digits) -> optional<int> {
+            if (digits.empty() || digits.size() > 6 || !all_of(digits.begin(), digits.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+                return nullopt;
+            }
+            return stoi(string(digits));
+        };
+        const auto first = number(range.substr(0, dash));
+        const auto last = dash == string_view::npos ? first : number(range.substr(dash + 1));
+        if (!first.has_value() || !last.has_value() || last.value() < first.value()) {
+            return {};
+        }
+        for (int cpu = first.value(); cpu <= last.value(); cpu++) {
+            cpus.push_back(cpu);
+        }
+        start = end == list.size() || list[end] == '\n' ? list.size() : end + 1;
+    }
+    return cpus;
+};
+
+auto allowed_cpus = []() -> vector<int> {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+};
+
+// Nodes without an allowed CPU are left out; without sysfs every allowed CPU is on node 0
+auto numa_topology = []() -> vector<NumaNode> {
+    const vector<int> allowed = allowed_cpus();
+    vector<NumaNode> nodes;
+    auto online = read_text("/sys/devices/system/node/online");
+    for (const int id : online.has_value() ? parse_cpu_list(online.value()) : vector<int>{}) {
+        auto list = read_text("/sys/devices/system/node/node" + to_string(id) + "/cpulist");
+        NumaNode node{id, {}};
+        for (const int cpu : list.has_value() ? parse_cpu_list(list.value()) : vector<int>{}) {
+            if (find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        if (!node.cpus.empty()) {
+            nodes.push_back(node);
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(NumaNode{0, allowed});
+    }
+    return nodes;
+};
+
+// false if none of the CPUs may be used
+auto pin_current_thread = [](const vector<int>& cpus) -> bool {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return !cpus.empty() && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+};
+
+// The CPUs node after node, so that consecutive workers share a node
+auto topology_cpus = [](const vector<NumaNode>& topology) -> vector<int> {
+    vector<int> cpus;
+    for (const NumaNode& node : topology) {
+        cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+    }
+    return cpus;
+};
+
+// For ThreadPool: worker i runs on the i-th CPU of cpus, round robin
+auto pin_workers_to = [](const vector<int> cpus) -> function<void(size_t)> {
+    return [cpus](const size_t worker) {
+        if (!cpus.empty()) {
+            pin_current_thread({cpus[worker % cpus.size()]});
+        }
+    };
+};
+
+// Consecutive chapters with about the same number of bytes for each node, as [begin, end) indices
+auto split_chapters_by_bytes = [](const auto& chapters, const size_t parts) -> vector<pair<size_t, size_t>> {
+    size_t total = 0;
+    for (const string_view chapter : chapters) {
+        total += chapter.size();
+    }
+    vector<pair<size_t, size_t>> ranges;
+    size_t chapter = 0;
+    size_t bytes = 0;
+    for (size_t part = 0; part < parts; part++) {
+        const size_t begin = chapter;
+        const size_t target = total * (part + 1) / parts;
+        while (chapter < chapters.size() && (part + 1 == parts || bytes + string_view(chapters[chapter]).size() / 2 <= target)) {
+            bytes += string_view(chapters[chapter]).size();
+            chapter++;
+        }
+        ranges.emplace_back(begin, chapter);
+    }
+    return ranges;
+};
+
+struct NodeStats {
+    int node = 0;
+    size_t workers = 0;
+    size_t chapters = 0;
+    size_t bytes = 0;
+    double milliseconds = 0;
+    bool pinned = false;
+
+    double megabytes_per_second() const {
+        return milliseconds > 0 ? bytes / milliseconds / 1000 : 0;
+    }
+};
+
+struct NumaRun {
+    vector<ChapterSummary> summaries;
+    vector<NodeStats> nodes;
+};
+
+// Every node gets its share of the chapters and threadsPerNode workers. A leader thread pinned to the
+// node copies the share into a buffer it allocates, so the text is read from local memory; with
+// pinCores every worker is also pinned to one core of its node.
+auto summarize_all_chapters_numa = [](const auto& chapters, const vector<NumaNode>& topology, const size_t threadsPerNode, const bool pinCores) {
+    return [&chapters, &topology, threadsPerNode, pinCores](const auto& filterPeaceTerms, const auto& filterWarTerms) -> NumaRun {
+        const auto shares = split_chapters_by_bytes(chapters, topology.size());
+        NumaRun run{vector<ChapterSummary>(chapters.size()), vector<NodeStats>(topology.size())};
+
+        auto lead = [&](const size_t k) {
+            const NumaNode& node = topology[k];
+            const size_t begin = shares[k].first;
+            const size_t end = shares[k].second;
+            atomic<bool> pinned{pin_current_thread(node.cpus)};
+            const auto started = chrono::steady_clock::now();
+
+            string local;
+            vector<size_t> offsets{0};
+            for (size_t i = begin; i < end; i++) {
+                local += string_view(chapters[i]);
+                offsets.push_back(local.size());
+            }
+
+            atomic<size_t> next{begin};
+            auto work = [&](const size_t worker) {
+                if (pinCores && !pin_current_thread({node.cpus[worker % node.cpus.size()]})) {
+                    pinned = false;
+                }
+                for (size_t i = next++; i < end; i = next++) {
+                    const string_view chapter(local.data() + offsets[i - begin], offsets[i - begin + 1] - offsets[i - begin]);
+                    run.summaries[i] = summarize_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+                }
+            };
+            const size_t workerCount = max<size_t>(threadsPerNode, 1);
+            vector<thread> workers;
+            for (size_t worker = 1; worker < workerCount; worker++) {
+                workers.emplace_back(work, worker);
+            }
+            work(0);
+            for (thread& worker : workers) {
+                worker.join();
+            }
+
+            run.nodes[k] = NodeStats{node.id, workerCount, end - begin, local.size(),
+                                     chrono::duration<double, milli>(chrono::steady_clock::now() - started).count(), pinned.load()};
+        };
+
+        vector<thread> leaders;
+        for (size_t k = 0; k < topology.size(); k++) {
+            leaders.emplace_back(lead, k);
+        }
+        for (thread& leader : leaders) {
+            leader.join();
+        }
+        return run;
+    };
+};
+
+auto print_node_stats = [](ostream& out, const vector<NodeStats>& nodes) {
+    for (const NodeStats& node : nodes) {
+        out << "Node " << node.node << ": " << node.workers << " workers" << (node.pinned ? " (pinned)" : " (not pinned)") << ", "
+            << node.chapters << " chapters, " << node.bytes << " bytes in " << node.milliseconds << " ms, "
+            << node.megabytes_per_second() << " MB/s" << endl;
+    }
+};
+#pragma endregion placement
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+using namespace std;
+
+// Ascending positions stored as group varint encoded deltas. A group is one control byte with the
+// byte length - 1 of the next four deltas in two bits each, followed by those 1 to 4 byte deltas.
+// Every blockSize positions start a new group and every block after the first gets a skip entry with
+// the position before the block and the byte offset of the block, so decoding can start at any block.
+#pragma region position list
+constexpr uint32_t positionBlockSize = 128;
+
+struct PositionSkip {
+    uint32_t base;
+    uint32_t offset;
+};
+
+// What decoding needs of a list, wherever its bytes are kept
+struct PositionListView {
+    const uint8_t* bytes;
+    size_t byteCount;
+    const PositionSkip* skips;
+    size_t skipCount;
+    uint32_t count;
+    uint32_t last;
+};
+
+struct PositionEncoder {
+    uint32_t count = 0;
+    uint32_t last = 0;
+    size_t control = 0;
+
+    // offset is where the list starts in bytes, the skip entries are relative to it
+    void push_back(const uint32_t position, vector<uint8_t>& bytes, vector<PositionSkip>& skips, const size_t offset) {
+        if (count > 0 && count % positionBlockSize == 0) {
+            skips.push_back(PositionSkip{last, uint32_t(bytes.size() - offset)});
+        }
+        if (count % 4 == 0) {
+            control = bytes.size();
+            bytes.push_back(0);
+        }
+
+        uint32_t delta = position - last;
+        uint8_t length = delta < (1u << 8) ? 1 : delta < (1u << 16) ? 2 : delta < (1u << 24) ? 3 : 4;
+        bytes[control] |= uint8_t((length - 1) << (2 * (count % 4)));
+        for (uint8_t i = 0; i < length; i++) {
+            bytes.push_back(uint8_t(delta >> (8 * i)));
+        }
+
+        last = position;
+        count++;
+    }
+};
+
+// A list that is appended to on its own
+struct PositionList {
+    vector<uint8_t> bytes;
+    vector<PositionSkip> skips;
+    PositionEncoder encoder;
+
+    size_t size() const {
+        return encoder.count;
+    }
+
+    void push_back(const uint32_t position) {
+        encoder.push_back(position, bytes, skips, 0);
+    }
+
+    PositionListView view() const {
+        return PositionListView{bytes.data(), bytes.size(), skips.data(), skips.size(), encoder.count, encoder.last};
+    }
+};
+
+// Where the four deltas of a group start after its control byte, and the bytes they take together
+struct GroupLayout {
+    array<uint8_t, 4> offsets;
+    uint8_t size;
+};
+
+constexpr array<GroupLayout, 256> groupLayouts = []() {
+    array<GroupLayout, 256> layouts{};
+    for (uint32_t control = 0; control < 256; control++) {
+        uint8_t offset = 0;
+        for (uint32_t k = 0; k < 4; k++) {
+            layouts[control].offsets[k] = offset;
+            offset += uint8_t(((control >> (2 * k)) & 3) + 1);
+        }
+        layouts[control].size = offset;
+    }
+    return layouts;
+}();
+
+// Calls action with every position of the block and of the blocks after it, until action returns false.
+// Full groups that are followed by at least 16 bytes are read with four 4 byte loads of a little endian
+// word at the offsets of their control byte; the rest byte by byte.
+template <typename Action>
+void decode_positions_from(const PositionListView& list, const size_t block, Action&& action) {
+    static constexpr uint32_t masks[4] = {0xFFu, 0xFFFFu, 0xFFFFFFu, 0xFFFFFFFFu};
+
+    const PositionSkip start = block == 0 ? PositionSkip{0, 0} : list.skips[block - 1];
+    const uint8_t* data = list.bytes + start.offset;
+    const uint8_t* end = list.bytes + list.byteCount;
+    uint32_t position = start.base;
+    uint32_t index = uint32_t(block) * positionBlockSize;
+    for (; index + 4 <= list.count && end - data >= 17; index += 4) {
+        const uint8_t control = *data++;
+        const GroupLayout& layout = groupLayouts[control];
+        for (uint32_t k = 0; k < 4; k++) {
+            uint32_t delta;
+            memcpy(&delta, data + layout.offsets[k], sizeof(delta));
+            position += delta & masks[(control >> (2 * k)) & 3];
+            if (!action(position)) {
+                return;
+            }
+        }
+        data += layout.size;
+    }
+    for (; index < list.count; index += 4) {
+        const uint8_t control = *data++;
+        const uint32_t groupSize = min(4u, list.count - index);
+        for (uint32_t k = 0; k < groupSize; k++) {
+            const uint32_t length = ((control >> (2 * k)) & 3) + 1;
+            uint32_t delta = 0;
+            for (uint32_t i = 0; i < length; i++) {
+                delta |= uint32_t(data[i]) << (8 * i);
+            }
+            data += length;
+            position += delta;
+            if (!action(position)) {
+                return;
+            }
+        }
+    }
+}
+
+auto for_each_position = [](const PositionListView& list, const auto& action) {
+    if (list.count == 0) {
+        return;
+    }
+    decode_positions_from(list, 0, [&](const uint32_t position) {
+        action(position);
+        return true;
+    });
+};
+
+auto decode_positions = [](const PositionListView& list) -> vector<uint32_t> {
+    vector<uint32_t> positions;
+    positions.reserve(list.count);
+    for_each_position(list, [&](const uint32_t position) { positions.push_back(position); });
+    return positions;
+};
+
+// First position not below target; only the block that can hold it and the ones after are decoded
+auto skip_to = [](const PositionListView& list, const uint32_t target) -> optional<uint32_t> {
+    if (list.count == 0 || list.last < target) {
+        return nullopt;
+    }
+    auto block = partition_point(list.skips, list.skips + list.skipCount, [target](const PositionSkip& skip) {
+        return skip.base < target;
+    }) - list.skips;
+
+    optional<uint32_t> found;
+    decode_positions_from(list, block, [&](const uint32_t position) {
+        if (position >= target) {
+            found = position;
+        }
+        return !found.has_value();
+    });
+    return found;
+};
+
+// The lists of every term in one byte pool and one skip pool, so a term costs 16 bytes besides its
+// encoded positions
+struct PositionIndexEntry {
+    uint32_t offset;
+    uint32_t skipOffset;
+    uint32_t count;
+    uint32_t last;
+};
+
+struct PositionIndex {
+    vector<uint8_t> bytes;
+    vector<PositionSkip> skips;
+    vector<PositionIndexEntry> entries;
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    PositionListView list(const uint32_t termId) const {
+        const PositionIndexEntry& entry = entries[termId];
+        const bool isLast = termId + 1 == entries.size();
+        const size_t byteEnd = isLast ? bytes.size() : entries[termId + 1].offset;
+        const size_t skipEnd = isLast ? skips.size() : entries[termId + 1].skipOffset;
+        return PositionListView{bytes.data() + entry.offset, byteEnd - entry.offset, skips.data() + entry.skipOffset,
+                                skipEnd - entry.skipOffset, entry.count, entry.last};
+    }
+
+    // Encodes the list of the next term; for_each_position calls the function it is given with every
+    // position of the term in ascending order
+    template <typename ForEachPosition>
+    void add_list(const ForEachPosition& for_each_position) {
+        const size_t offset = bytes.size();
+        const size_t skipOffset = skips.size();
+        PositionEncoder encoder;
+        for_each_position([&](const uint32_t position) { encoder.push_back(position, bytes, skips, offset); });
+        entries.push_back(PositionIndexEntry{uint32_t(offset), uint32_t(skipOffset), encoder.count, encoder.last});
+    }
+
+    void shrink_to_fit() {
+        bytes.shrink_to_fit();
+        skips.shrink_to_fit();
+        entries.shrink_to_fit();
+    }
+
+    size_t memory() const {
+        return bytes.capacity() + skips.capacity() * sizeof(PositionSkip) + entries.capacity() * sizeof(PositionIndexEntry);
+    }
+};
+
+// Positions of every term of a block of term ids and positions by term id; the tokens are first
+// grouped by term so that every list is encoded in one piece
+auto build_position_index = [](const auto& block, const size_t termCount) -> PositionIndex {
+    vector<uint32_t> firstToken(termCount + 1, 0);
+    for (uint32_t termId : block.termIds) {
+        firstToken[termId + 1]++;
+    }
+    partial_sum(firstToken.begin(), firstToken.end(), firstToken.begin());
+
+    vector<uint32_t> grouped(block.size());
+    vector<uint32_t> next(firstToken.begin(), firstToken.end() - 1);
+    for (size_t i = 0; i < block.size(); i++) {
+        grouped[next[block.termIds[i]]++] = block.positions[i];
+    }
+
+    PositionIndex index;
+    index.entries.reserve(termCount);
+    for (size_t termId = 0; termId < termCount; termId++) {
+        index.add_list([&](const auto& add) {
+            for (uint32_t token = firstToken[termId]; token < firstToken[termId + 1]; token++) {
+                add(grouped[token]);
+            }
+        });
+    }
+    index.shrink_to_fit();
+    return index;
+};
+#pragma endregion position list
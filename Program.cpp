@@ -1,248 +1,296 @@
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include <optional>
-#include <algorithm>
-#include <iterator>
-#include <string>
-#include <functional>
-#include <numeric>
-#include <map>
-#include <regex>
-#include <sstream>
-
-using namespace std;
-using namespace std::placeholders;
-
-struct Word {
-    string str;
-    int indexInText;
-
-    bool operator==(const Word& other) const {
-        return str == other.str && indexInText == other.indexInText;
-    }
-};
-
-struct WordCount{
-    string word;
-    int count;
-};
-
-enum struct Relation {
-    WAR = 0,
-    PEACE = 1
-};
-
-void print_evaluations(const map<int, Relation>& evaluations) {
-    for_each(evaluations.begin(), evaluations.end(), [](const auto& pair) {
-        cout << "Chapter " << pair.first << ": " << relationToString(pair.second) << "-related" << endl;
-    });
-}
-
-#pragma region IO Reading
-//Step 2: Read files
-auto read_lines = [](const string& filePath) -> optional<vector<string>> {
-    ifstream inputFile(filePath);
-
-    if(inputFile.is_open()){
-        vector<string> values;
-
-        string line;
-        while(getline(inputFile, line)){
-            values.push_back(line);
-        }
-
-        return values;
-    }
-    else{
-        return nullopt;
-    }
-};
-#pragma endregion IO Reading
-
-#pragma region tokenize
-//Step 3: Tokenize the text
-auto remove_special_characters = [](string str) {
-    str.erase(remove_if(str.begin(), str.end(), [](char c) {
-        return !isalnum(c) && c != ' ';
-    }), str.end());
-    return str;
-};
-
-auto tokenize = [](const string& line, const char separator) -> vector<Word> {
-    vector<Word> splittedWords;
-
-    vector<string> tokens;
-    istringstream iss(line);
-    string token;
-    int index = 0;
-    while (getline(iss, token, separator)) {
-        tokens.push_back(token);
-    }
-
-    transform(tokens.begin(), tokens.end(), std::back_inserter(splittedWords), [&](const std::string& token) {
-        string subString = remove_special_characters(token);
-
-        transform(subString.begin(), subString.end(), subString.begin(), [](unsigned char c) {
-            return tolower(c);
-        });
-
-        if (!subString.empty()) {
-            Word word{subString, index};
-            index += token.size() + 1; // Increment index by the size of the token plus 1 for the separator
-            return word;
-        } else {
-            return Word{};
-        }
-    });
-
-    return splittedWords;
-};
-
-auto split_book_into_chapters = [](const string& book) -> vector<string> {
-    regex chapter_regex(R"(CHAPTER \d+)");
-    sregex_token_iterator chapters_begin(book.begin(), book.end(), chapter_regex, -1);
-    sregex_token_iterator chapters_end;
-    vector<string> chapters(chapters_begin, chapters_end);
-    chapters.erase(chapters.begin());
-    return chapters;
-};
-
-//Step 4: Filter the words
-auto filter_words = [](const vector<Word>& words, const vector<string>& filter) -> vector<Word> {
-    vector<Word> filterWords;
-
-    copy_if(words.begin(), words.end(), back_inserter(filterWords), [=](const Word& word){
-        return std::find_if(filter.begin(), filter.end(), [&](const std::string& filterWord) {
-            return filterWord == word.str;
-        }) != filter.end();
-    });
-
-    return filterWords;
-};
-
-// Step 5: Count occurrences
-auto calculate_wordCount = [](const map<string, vector<Word>>& wordMap) -> vector<WordCount> {
-    vector<WordCount> result;
-
-    for_each(wordMap.begin(), wordMap.end(), [&](const pair<string, vector<Word>>& pair){
-        int wordCount = pair.second.size();
-        WordCount current {pair.first, wordCount};
-        result.push_back(current);
-    });
-
-    return result;
-};
-#pragma endregion tokenize
-
-#pragma region map words
-auto map_words = [](const vector<Word>& words) -> map<string, vector<Word>> {
-    map<string, vector<Word>> wordMap;
-    for_each(words.begin(), words.end(), [&wordMap](const Word& word) {
-        wordMap[word.str].push_back(word);
-    });
-    return wordMap;
-};
-
-// Step 6: Calculate term density
-auto calculate_density = [](const vector<Word>& words) -> double {
-    if(words.size() < 2){
-        return -1.0;
-    }
-
-    double distanceSum = accumulate(words.begin(), words.end() - 1, 0.0, [](double sum, const Word& word){
-        auto next = &word + 1;
-        int distance = next->indexInText - word.indexInText;
-        return sum + distance;
-    });
-
-    return distanceSum / (words.size() - 1);
-};
-
-auto get_relation_value = [](const vector<WordCount>& wordData, const double& density){
-    int sumCount = accumulate(wordData.begin(), wordData.end(), 0, [](const int accumulator, const WordCount& item){
-        return accumulator + item.count;
-    });
-
-    return sumCount + (200 - density);
-};
-#pragma endregion map words
-
-const string relationToString(const Relation rel) {
-    switch (rel) {
-        case Relation::WAR:
-            return "war";
-        case Relation::PEACE:
-            return "peace";
-        default:
-            return "UNKNOWN";
-    }
-}
-
-auto process_chapter = [](const string& chapter) {
-    return [chapter](const auto& filterPeaceTerms, const auto& filterWarTerms) -> Relation {
-        auto chapter_words = tokenize(chapter, ' ');
-
-        auto warWords = filterWarTerms(chapter_words);
-        auto peaceWords = filterPeaceTerms(chapter_words);
-
-        auto warMap = map_words(warWords);
-        auto peaceMap = map_words(peaceWords);
-
-        auto warResult = calculate_wordCount(warMap);
-        auto peaceResult = calculate_wordCount(peaceMap);
-
-        auto warDensity = calculate_density(warWords);
-        auto peaceDensity = calculate_density(peaceWords);
-
-        int warRelationValue = get_relation_value(warResult, warDensity);
-        int peaceRelationValue = get_relation_value(peaceResult, peaceDensity);
-
-        return ((warRelationValue > peaceRelationValue) ? Relation::WAR : Relation::PEACE);
-    };
-};
-
-auto process_all_chapters = [](const vector<string>& chapters) {
-    return [chapters](const auto& filterPeaceTerms, const auto& filterWarTerms) -> map<int, Relation> {
-        map<int, Relation> chapter_densities;
-        transform(chapters.begin(), chapters.end(), inserter(chapter_densities, chapter_densities.begin()),
-              [&](const string& chapter) {
-                  static int chapter_number = 1;
-                  return make_pair(chapter_number++, process_chapter(chapter)(filterPeaceTerms, filterWarTerms));
-              });
-        return chapter_densities;
-    };
-};
-
-//Step 1
-int main() {
-    // Step 7: Read input files and tokenize the text
-    auto peaceTerms = read_lines("./data/peace_terms.txt").value();
-    auto warTerms = read_lines("./data/war_terms.txt").value();
-    if(peaceTerms.empty() || warTerms.empty()){
-        cout << "Error reading peace_terms.txt or war_terms.txt" << endl;
-        return 1;
-    }
-
-    auto book = read_lines("./data/book.txt");
-    if (!book.has_value()) {
-        cout << "Error reading book.txt" << endl;
-        return 1;
-    }
-
-    const auto bookv = book.value();
-    auto book_string = accumulate(bookv.begin(), bookv.end(), string(), [](string accumulator, const string& line){
-        return accumulator + line + " ";
-    });
-
-    auto filterPeaceTerms = bind(filter_words, _1, peaceTerms);
-    auto filterWarTerms = bind(filter_words, _1, warTerms);
-
-    auto chapters = split_book_into_chapters(book_string);
-
-    auto chapter_densities = process_all_chapters(chapters)(filterPeaceTerms, filterWarTerms);
-
-    print_evaluations(chapter_densities);
-
-    return 0;
-}
\ No newline at end of file
+#include "TextAnalyzer.h"
+#include "Lexicon.h"
+#include "LexiconRegistry.h"
+#include "CompiledLexicon.h"
+#include "DocumentIndex.h"
+#include "SectionPattern.h"
+#include "ChapterSelection.h"
+#include "ThreadPool.h"
+#include "WorkStealing.h"
+#include "Pipeline.h"
+#include "ParallelAlgorithms.h"
+#include "CorpusStatistics.h"
+#include "Placement.h"
+#include "AsyncAnalysis.h"
+#include "MultiProcess.h"
+#ifdef USE_GENERATED_LEXICON
+#include "GeneratedMatcher.h"
+#endif
+
+// Keeps running and prints a new evaluation whenever peace_terms.txt or war_terms.txt change
+int watch_lexicons(const vector<string_view>& chapters, const bool fuzzy) {
+    const string peacePath = "./data/peace_terms.txt";
+    const string warPath = "./data/war_terms.txt";
+    auto lexicons = load_lexicon_set(peacePath, warPath);
+    if(!lexicons.has_value()){
+        cout << "Error reading peace_terms.txt or war_terms.txt" << endl;
+        return 1;
+    }
+
+    LexiconRegistry registry(std::move(lexicons.value()));
+    LexiconWatcher watcher(registry, peacePath, warPath);
+    uint64_t evaluated = 0;
+    while(true){
+        if(registry.version() == evaluated){
+            this_thread::sleep_for(chrono::milliseconds(100));
+            continue;
+        }
+        evaluated = registry.version();
+        print_evaluations(process_all_chapters_live(chapters, registry, fuzzy));
+        cout << "-- lexicon version " << evaluated << ", waiting for changes --" << endl;
+    }
+}
+
+//Step 1
+int main(int argc, char* argv[]) {
+    const vector<string> args(argv + 1, argv + argc);
+    auto hasOption = [&args](const string& option) {
+        return find(args.begin(), args.end(), option) != args.end();
+    };
+    auto optionValue = [&args](const string& option) -> optional<string> {
+        auto found = find(args.begin(), args.end(), option);
+        if(found == args.end() || found + 1 == args.end()){
+            return nullopt;
+        }
+        return *(found + 1);
+    };
+    auto optionValues = [&args](const string& option) -> vector<string> {
+        vector<string> values;
+        for(size_t i = 0; i + 1 < args.size(); i++){
+            if(args[i] == option){
+                values.push_back(args[i + 1]);
+            }
+        }
+        return values;
+    };
+    const bool fuzzy = hasOption("--fuzzy");
+    const bool structure = hasOption("--structure");
+    const bool verbose = hasOption("--verbose");
+    const auto compiledLexiconPath = optionValue("--lexicon");
+    const auto chapterSelection = optionValue("--chapters");
+    const auto threadOption = optionValue("--threads");
+    const size_t threadCount = threadOption.has_value() ? max(atoi(threadOption->c_str()), 1) : default_thread_count();
+    const auto reorderWindowOption = optionValue("--reorder-window");
+    const size_t reorderWindow = reorderWindowOption.has_value() ? max(atoi(reorderWindowOption->c_str()), 1) : defaultReorderWindow;
+    const string bookPath = "./data/book.txt";
+    // with --pin-threads worker i of a pool or of --work-stealing only runs on the i-th CPU, counted node after node
+    const bool pinThreads = hasOption("--pin-threads");
+    auto pool_start = [pinThreads]() -> function<void(size_t)> {
+        return pinThreads ? pin_workers_to(topology_cpus(numa_topology())) : nullptr;
+    };
+
+    // Step 7: Read input files and tokenize the text. The text term lists are only read by the
+    // filters that match against them, so a compiled lexicon starts without parsing them.
+    auto read_term_lists = []() -> optional<pair<vector<string>, vector<string>>> {
+        auto peaceTerms = read_terms("./data/peace_terms.txt");
+        auto warTerms = read_terms("./data/war_terms.txt");
+        if(!peaceTerms.has_value() || !warTerms.has_value() || peaceTerms->empty() || warTerms->empty()){
+            cout << "Error reading peace_terms.txt or war_terms.txt" << endl;
+            return nullopt;
+        }
+        return make_pair(std::move(peaceTerms.value()), std::move(warTerms.value()));
+    };
+
+    // Calls analyze with the peace and war filters selected by the options; they append to the
+    // vectors the chapter passes them, which live in the chapter arena
+    auto with_filters = [&](const auto& analyze) -> int {
+        if(compiledLexiconPath.has_value()){
+            const auto lexicon = load_compiled_lexicon(compiledLexiconPath.value());
+            if(!lexicon.has_value()){
+                cout << "Error loading compiled lexicon " << compiledLexiconPath.value() << endl;
+                return 1;
+            }
+            return analyze(bind(compiled_filter_words_into, _1, cref(lexicon.value()), Relation::PEACE, _2),
+                           bind(compiled_filter_words_into, _1, cref(lexicon.value()), Relation::WAR, _2));
+        }
+        if(fuzzy){
+            const auto terms = read_term_lists();
+            if(!terms.has_value()){
+                return 1;
+            }
+            const auto peaceIndex = build_deletion_index(terms->first);
+            const auto warIndex = build_deletion_index(terms->second);
+            return analyze(bind(fuzzy_filter_words_into, _1, cref(peaceIndex), _2),
+                           bind(fuzzy_filter_words_into, _1, cref(warIndex), _2));
+        }
+#ifdef USE_GENERATED_LEXICON
+        // the terms were compiled into the binary, see 'make TextAnalyzerGenerated'
+        return analyze(bind(generated_filter_words_into, _1, Relation::PEACE, _2),
+                       bind(generated_filter_words_into, _1, Relation::WAR, _2));
+#else
+        const auto terms = read_term_lists();
+        if(!terms.has_value()){
+            return 1;
+        }
+        return analyze(bind(filter_words_into, _1, cref(terms->first), _2), bind(filter_words_into, _1, cref(terms->second), _2));
+#endif
+    };
+
+    // only the selected chapters are read, their offsets come from the sidecar in ./out
+    if(chapterSelection.has_value()){
+        const auto selection = parse_chapter_selection(chapterSelection.value());
+        if(!selection.has_value()){
+            cout << "Invalid chapter selection: " << chapterSelection.value() << ", expected N or N..M" << endl;
+            return 1;
+        }
+        const auto chapterRanges = load_chapter_ranges(bookPath, "./out/book.txt.chapters");
+        if(!chapterRanges.has_value()){
+            cout << "Error reading book.txt" << endl;
+            return 1;
+        }
+        if(size_t(selection->second) > chapterRanges->size()){
+            cout << "The book has " << chapterRanges->size() << " chapters" << endl;
+            return 1;
+        }
+        return with_filters([&](const auto& filterPeaceTerms, const auto& filterWarTerms) {
+            auto chapter_densities = process_chapter_selection(bookPath, chapterRanges.value(), selection.value())(filterPeaceTerms, filterWarTerms);
+            if(!chapter_densities.has_value()){
+                cout << "Error reading book.txt" << endl;
+                return 1;
+            }
+            print_evaluations(chapter_densities.value());
+            return 0;
+        });
+    }
+
+    // chapters are scored while the book is still being read and printed as soon as all before them are
+    if(hasOption("--pipeline")){
+        return with_filters([&](const auto& filterPeaceTerms, const auto& filterWarTerms) {
+            auto print = [](const int chapter, const ChapterSummary& summary) { print_evaluation(chapter, summary.relation); };
+            auto stats = stream_chapters(bookPath, threadCount, reorderWindow, print)(filterPeaceTerms, filterWarTerms);
+            if(!stats.has_value()){
+                cout << "Error reading book.txt" << endl;
+                return 1;
+            }
+            print_pipeline_stats(cerr, stats.value());
+            return 0;
+        });
+    }
+
+    // the coroutines of AsyncAnalysis.h on an event loop of their own, waited for here
+    if(hasOption("--async")){
+        return with_filters([&](const auto& filterPeaceTerms, const auto& filterWarTerms) {
+            auto chapter_densities = process_book(bookPath)(filterPeaceTerms, filterWarTerms);
+            if(!chapter_densities.has_value()){
+                cout << "Error reading book.txt" << endl;
+                return 1;
+            }
+            print_evaluations(chapter_densities.value());
+            return 0;
+        });
+    }
+
+    auto book = read_text(bookPath);
+    if (!book.has_value()) {
+        cout << "Error reading book.txt" << endl;
+        return 1;
+    }
+
+    // --structure indexes the whole file, so the index has its real front and back matter
+    const optional<DocumentIndex> index = structure ? optional<DocumentIndex>(index_document(book.value())) : nullopt;
+
+    // everything after this only sees the text between the Gutenberg header and the license
+    const auto body = find_gutenberg_body(book.value());
+    book->erase(body.end);
+    book->erase(0, body.begin);
+
+    const auto book_string = flatten_lines(std::move(book.value()));
+
+    vector<SectionPattern> sectionPatterns;
+    for(const string& pattern : optionValues("--section-pattern")){
+        auto parsed = parse_section_pattern(pattern);
+        if(!parsed.has_value()){
+            cout << "Invalid section pattern: " << pattern << endl;
+            return 1;
+        }
+        sectionPatterns.push_back(parsed.value());
+    }
+
+    auto chapters = structure ? chapter_views(book_string, index.value(), body.begin)
+                  : !sectionPatterns.empty() ? split_into_section_views(book_string, compile_section_patterns(sectionPatterns))
+                  : split_book_into_chapter_views(book_string);
+
+    // term frequencies over the chapters of the book and of every --corpus book
+    const auto termFrequencies = optionValue("--term-frequencies");
+    if(termFrequencies.has_value()){
+        const auto corpusPaths = optionValues("--corpus");
+        vector<string> corpusBooks;
+        corpusBooks.reserve(corpusPaths.size());
+        for(const string& path : corpusPaths){
+            auto text = read_text(path);
+            if(!text.has_value()){
+                cout << "Error reading " << path << endl;
+                return 1;
+            }
+            const auto corpusBody = find_gutenberg_body(text.value());
+            corpusBooks.push_back(flatten_lines(text->substr(corpusBody.begin, corpusBody.end - corpusBody.begin)));
+        }
+        vector<string_view> corpusChapters(chapters.begin(), chapters.end());
+        for(const string& corpusBook : corpusBooks){
+            const auto bookChapters = split_book_into_chapter_views(corpusBook);
+            corpusChapters.insert(corpusChapters.end(), bookChapters.begin(), bookChapters.end());
+        }
+        ThreadPool pool(threadCount, pool_start());
+        print_corpus_word_counts(count_corpus_terms(corpusChapters, pool), size_t(max(atoi(termFrequencies->c_str()), 0)));
+        return 0;
+    }
+
+    if(hasOption("--watch")){
+        return watch_lexicons(chapters, fuzzy);
+    }
+
+    return with_filters([&](const auto& filterPeaceTerms, const auto& filterWarTerms) {
+        if(structure){
+            ThreadPool pool(threadCount, pool_start());
+            print_structure(index.value(), summarize_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms));
+        }
+        else if(verbose){
+            int chapterNumber = 1;
+            for(const string_view chapter : chapters){
+                print_chapter_detail(chapterNumber++, detail_chapter(chapter)(filterPeaceTerms, filterWarTerms));
+            }
+        }
+        else if(hasOption("--work-stealing")){
+            auto run = summarize_all_chapters_stealing(chapters, threadCount, default_grain_size(book_string.size(), threadCount),
+                                                       pool_start())(filterPeaceTerms, filterWarTerms);
+            map<int, Relation> chapter_densities;
+            for(size_t i = 0; i < run.summaries.size(); i++){
+                chapter_densities[int(i + 1)] = run.summaries[i].relation;
+            }
+            print_evaluations(chapter_densities);
+            print_worker_stats(cerr, run.workers);
+        }
+        else if(hasOption("--numa")){
+            const auto topology = numa_topology();
+            auto run = summarize_all_chapters_numa(chapters, topology, max<size_t>(threadCount / topology.size(), 1), pinThreads)(filterPeaceTerms, filterWarTerms);
+            vector<Relation> relations(run.summaries.size());
+            transform(run.summaries.begin(), run.summaries.end(), relations.begin(), [](const ChapterSummary& summary) { return summary.relation; });
+            print_evaluations(number_chapters(relations));
+            print_node_stats(cerr, run.nodes);
+        }
+        else if(hasOption("--processes")){
+            auto run = summarize_all_chapters_forked(chapters, threadCount)(filterPeaceTerms, filterWarTerms);
+            if(!run.has_value()){
+                cout << "Error creating shared memory for the worker processes" << endl;
+                return 1;
+            }
+            vector<Relation> relations(run->summaries.size());
+            transform(run->summaries.begin(), run->summaries.end(), relations.begin(), [](const ChapterSummary& summary) { return summary.relation; });
+            print_evaluations(number_chapters(relations));
+            print_process_stats(cerr, run->stats);
+        }
+        else if(hasOption("--parallel-stl")){
+            print_evaluations(process_all_chapters_parallel_stl(chapters)(filterPeaceTerms, filterWarTerms));
+        }
+        else if(threadCount > 1){
+            // every chapter is printed as soon as it and all before it are done
+            ThreadPool pool(threadCount, pool_start());
+            auto print = [](const int chapter, const ChapterSummary& summary) { print_evaluation(chapter, summary.relation); };
+            stream_all_chapters_parallel(chapters, pool, reorderWindow, print)(filterPeaceTerms, filterWarTerms);
+        }
+        else{
+            print_evaluations(process_all_chapters(chapters)(filterPeaceTerms, filterWarTerms));
+        }
+        return 0;
+    });
+}
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+#include "TextAnalyzer.h"
+
+// Section headings are described by small patterns such as "CHAPTER {digits}", "Chapter {roman}",
+// "CHAPTER THE {upper}" or "Part {digits}". Characters match themselves, a backslash escapes the
+// next character and a class in braces matches one or more characters of that class:
+//
+//   {digits}  0-9            {upper}  A-Z            {alpha}  A-Z and a-z
+//   {roman}   IVXLCDM        {lower}  a-z
+//
+// All patterns are compiled together into one DFA over bytes with a flat transition table.
+#pragma region section patterns
+struct PatternItem {
+    bitset<256> bytes;
+    bool repeat;
+};
+
+using SectionPattern = vector<PatternItem>;
+
+auto character_class = [](const string_view name) -> optional<bitset<256>> {
+    bitset<256> bytes;
+    auto add_range = [&bytes](char first, char last) {
+        for(int c = first; c <= last; c++){
+            bytes.set(c);
+        }
+    };
+    if(name == "digits"){
+        add_range('0', '9');
+    }
+    else if(name == "upper"){
+        add_range('A', 'Z');
+    }
+    else if(name == "lower"){
+        add_range('a', 'z');
+    }
+    else if(name == "alpha"){
+        add_range('A', 'Z');
+        add_range('a', 'z');
+    }
+    else if(name == "roman"){
+        for(char c : string_view("IVXLCDM")){
+            bytes.set(static_cast<unsigned char>(c));
+        }
+    }
+    else{
+        return nullopt;
+    }
+    return bytes;
+};
+
+// nullopt for an empty pattern, an unknown class, an unclosed brace or a trailing backslash
+auto parse_section_pattern = [](const string_view pattern) -> optional<SectionPattern> {
+    SectionPattern items;
+    for(size_t i = 0; i < pattern.size(); i++){
+        if(pattern[i] == '{'){
+            size_t close = pattern.find('}', i);
+            if(close == string_view::npos){
+                return nullopt;
+            }
+            auto bytes = character_class(pattern.substr(i + 1, close - i - 1));
+            if(!bytes.has_value()){
+                return nullopt;
+            }
+            items.push_back(PatternItem{bytes.value(), true});
+            i = close;
+            continue;
+        }
+        if(pattern[i] == '\\'){
+            if(++i == pattern.size()){
+                return nullopt;
+            }
+        }
+        PatternItem literal{{}, false};
+        literal.bytes.set(static_cast<unsigned char>(pattern[i]));
+        items.push_back(literal);
+    }
+    if(items.empty()){
+        return nullopt;
+    }
+    return items;
+};
+
+// State 0 is the dead state and state 1 the start state. accepting holds the first pattern that
+// matches in a state, or -1. The search automaton tries every pattern from every byte at once:
+// each of its states also holds the starts of all patterns, and its state 1 is the one in which no
+// heading that began earlier is still being read.
+struct SectionDfa {
+    vector<uint32_t> transitions;
+    vector<int> accepting;
+    vector<uint32_t> searchTransitions;
+    bitset<256> startBytes;
+
+    uint32_t next(uint32_t state, unsigned char byte) const {
+        return transitions[size_t(state) * 256 + byte];
+    }
+
+    uint32_t search_next(uint32_t state, unsigned char byte) const {
+        return searchTransitions[size_t(state) * 256 + byte];
+    }
+};
+
+// Subset construction over the NFA whose states are (pattern, item) positions; a repeated item
+// that has matched once may match again or be left
+auto compile_section_patterns = [](const vector<SectionPattern>& patterns) -> SectionDfa {
+    using NfaState = pair<uint32_t, uint32_t>;
+    using NfaSet = vector<NfaState>;
+
+    NfaSet start;
+    for(uint32_t p = 0; p < patterns.size(); p++){
+        start.emplace_back(p, 0);
+    }
+
+    // With restart the start positions join every set, so a heading may begin at any byte
+    auto determinize = [&](const bool restart) -> pair<vector<uint32_t>, vector<int>> {
+        vector<uint32_t> transitions;
+        vector<int> accepting;
+        map<NfaSet, uint32_t> ids;
+        vector<NfaSet> sets;
+
+        auto add_state = [&](const NfaSet& set) -> uint32_t {
+            auto known = ids.find(set);
+            if(known != ids.end()){
+                return known->second;
+            }
+            uint32_t id = uint32_t(sets.size());
+            ids.emplace(set, id);
+            sets.push_back(set);
+            transitions.resize(sets.size() * 256, 0);
+            int accepts = -1;
+            for_each(set.begin(), set.end(), [&](const NfaState& state) {
+                if(state.second == patterns[state.first].size() && (accepts == -1 || int(state.first) < accepts)){
+                    accepts = int(state.first);
+                }
+            });
+            accepting.push_back(accepts);
+            return id;
+        };
+
+        add_state({});
+        add_state(start);
+
+        for(uint32_t id = 1; id < sets.size(); id++){
+            for(int byte = 0; byte < 256; byte++){
+                NfaSet next;
+                for_each(sets[id].begin(), sets[id].end(), [&](const NfaState& state) {
+                    const SectionPattern& pattern = patterns[state.first];
+                    // a finished repeat may continue with its own class
+                    if(state.second > 0 && pattern[state.second - 1].repeat && pattern[state.second - 1].bytes[byte]){
+                        next.emplace_back(state.first, state.second);
+                    }
+                    if(state.second < pattern.size() && pattern[state.second].bytes[byte]){
+                        next.emplace_back(state.first, state.second + 1);
+                    }
+                });
+                if(restart){
+                    next.insert(next.end(), start.begin(), start.end());
+                }
+                sort(next.begin(), next.end());
+                next.erase(unique(next.begin(), next.end()), next.end());
+                uint32_t target = next.empty() ? 0 : add_state(next);
+                transitions[size_t(id) * 256 + byte] = target;
+            }
+        }
+        return {transitions, accepting};
+    };
+
+    SectionDfa dfa;
+    tie(dfa.transitions, dfa.accepting) = determinize(false);
+    dfa.searchTransitions = determinize(true).first;
+    for(int byte = 0; byte < 256; byte++){
+        dfa.startBytes[byte] = dfa.next(1, byte) != 0;
+    }
+    return dfa;
+};
+
+// End of the longest heading starting at offset at, if any
+auto match_section_heading = [](const SectionDfa& dfa, const string_view text, size_t at) -> optional<size_t> {
+    optional<size_t> end;
+    for(uint32_t state = 1; at < text.size();){
+        state = dfa.next(state, static_cast<unsigned char>(text[at++]));
+        if(state == 0){
+            break;
+        }
+        if(dfa.accepting[state] >= 0){
+            end = at;
+        }
+    }
+    return end;
+};
+
+// Same contract as find_chapter_ranges: the heading that starts first wins, the longest one if
+// several start there, and the next heading is searched after its end. Every byte is read at most
+// twice, so the scan is linear in the text for any patterns:
+// - the search automaton cuts the text into stretches in which a heading is being read; a heading
+//   lies inside one stretch. Between stretches the scan skips to the next byte a heading can start
+//   with, by memchr when the patterns start with only a few distinct bytes.
+// - every stretch is read once more backward, keeping for each DFA state the end of the longest
+//   heading the DFA reaches from it, which gives the longest heading from every byte of the stretch.
+auto find_section_ranges = [](const string_view text, const SectionDfa& dfa) -> vector<ChapterRange> {
+    vector<ChapterRange> ranges;
+    optional<size_t> sectionBegin;
+
+    vector<unsigned char> startBytes;
+    for(int byte = 0; byte < 256; byte++){
+        if(dfa.startBytes[byte]){
+            startBytes.push_back(static_cast<unsigned char>(byte));
+        }
+    }
+    const bool searchByMemchr = startBytes.size() <= 8;
+    vector<size_t> nextOccurrence(startBytes.size(), 0);
+    array<bool, 256> isStartByte{};
+    for_each(startBytes.begin(), startBytes.end(), [&isStartByte](unsigned char byte) { isStartByte[byte] = true; });
+
+    auto next_candidate = [&](const size_t position) -> size_t {
+        if(!searchByMemchr){
+            size_t at = position;
+            while(at < text.size() && !isStartByte[static_cast<unsigned char>(text[at])]){
+                at++;
+            }
+            return at;
+        }
+        size_t at = text.size();
+        for(size_t i = 0; i < startBytes.size(); i++){
+            if(nextOccurrence[i] < position){
+                const void* found = memchr(text.data() + position, startBytes[i], text.size() - position);
+                nextOccurrence[i] = found == nullptr ? text.size() : static_cast<const char*>(found) - text.data();
+            }
+            at = min(at, nextOccurrence[i]);
+        }
+        return at;
+    };
+
+    constexpr size_t none = string_view::npos;
+    vector<size_t> longest(dfa.accepting.size());
+    vector<size_t> longestAfter(dfa.accepting.size());
+    vector<ChapterRange> headings;
+
+    size_t position = 0;
+    while(position < text.size()){
+        const size_t stretchBegin = next_candidate(position);
+        if(stretchBegin >= text.size()){
+            break;
+        }
+        size_t stretchEnd = stretchBegin;
+        uint32_t searchState = 1;
+        do{
+            searchState = dfa.search_next(searchState, static_cast<unsigned char>(text[stretchEnd++]));
+        } while(searchState != 1 && stretchEnd < text.size());
+
+        // longest[q]: end of the longest heading the DFA reaches from state q at offset at. Nothing
+        // that starts inside the stretch is read past its end.
+        for(size_t q = 0; q < longest.size(); q++){
+            longest[q] = dfa.accepting[q] >= 0 ? stretchEnd : none;
+        }
+        headings.clear();
+        for(size_t at = stretchEnd; at-- > stretchBegin;){
+            swap(longest, longestAfter);
+            const unsigned char byte = static_cast<unsigned char>(text[at]);
+            longest[0] = none;
+            for(uint32_t q = 1; q < longest.size(); q++){
+                const size_t after = longestAfter[dfa.next(q, byte)];
+                longest[q] = after != none ? after : dfa.accepting[q] >= 0 ? at : none;
+            }
+            if(longest[1] != none){
+                headings.push_back(ChapterRange{at, longest[1]});
+            }
+        }
+
+        for(auto heading = headings.rbegin(); heading != headings.rend(); heading++){
+            if(heading->begin < position){
+                continue;
+            }
+            if(sectionBegin.has_value()){
+                ranges.push_back(ChapterRange{sectionBegin.value(), heading->begin});
+            }
+            sectionBegin = heading->end;
+            position = heading->end;
+        }
+        position = stretchEnd;
+    }
+
+    if(sectionBegin.has_value() && sectionBegin.value() < text.size()){
+        ranges.push_back(ChapterRange{sectionBegin.value(), text.size()});
+    }
+    return ranges;
+};
+
+auto split_into_section_views = [](const string_view text, const SectionDfa& dfa) -> vector<string_view> {
+    auto ranges = find_section_ranges(text, dfa);
+    vector<string_view> sections;
+    sections.reserve(ranges.size());
+    transform(ranges.begin(), ranges.end(), back_inserter(sections), [text](const ChapterRange& range) {
+        return text.substr(range.begin, range.end - range.begin);
+    });
+    return sections;
+};
+#pragma endregion section patterns
@@ -1,179 +1,50 @@
-#include <iostream>
-#include <vector>
-#include <fstream>
-#include <optional>
-#include <algorithm>
-#include <iterator>
-#include <string>
-#include <functional>
-#include <numeric>
-#include <map>
-#include <regex>
-#include <sstream>
-
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
-using namespace std;
-
-struct Word {
-    string str;
-    int indexInText;
-
-    bool operator==(const Word& other) const {
-        return str == other.str && indexInText == other.indexInText;
-    }
-};
-
-struct WordCount{
-    string word;
-    int count;
-
-    bool operator==(const WordCount& other) const {
-        return word == other.word && count == other.count;
-    }
-};
-
-enum struct Relation {
-    WAR = 0,
-    PEACE = 1
-};
-
-const string relationToString(const Relation rel) {
-    switch (rel) {
-        case Relation::WAR:
-            return "war";
-        case Relation::PEACE:
-            return "peace";
-        default:
-            return "UNKNOWN";
-    }
-}
-
-auto remove_special_characters = [](string str) {
-    str.erase(remove_if(str.begin(), str.end(), [](char c) {
-        return !isalnum(c) && c != ' ';
-    }), str.end());
-    return str;
-};
-
+#include "TextAnalyzer.h"
+#include "Lexicon.h"
+#include "LexiconRegistry.h"
+#include "CompiledLexicon.h"
+#include "GeneratedMatcher.h"
+#include "DocumentIndex.h"
+#include "SectionPattern.h"
+#include "ChapterSelection.h"
+#include "PositionList.h"
+#include "ThreadPool.h"
+#include "WorkStealing.h"
+#include "Pipeline.h"
+#include "ParallelAlgorithms.h"
+#include "CorpusStatistics.h"
+#include "Placement.h"
+#include "AsyncAnalysis.h"
+#include "MultiProcess.h"
+#include <random>
+#include <set>
 
-auto tokenize = [](const string& line, const char separator) -> vector<Word> {
-    vector<Word> splittedWords;
+// filter_words_into over a term list of its own, as the analyses take their filters
+struct TermFilter {
+    vector<string> terms;
 
-    vector<string> tokens;
-    istringstream iss(line);
-    string token;
-    int index = 0;
-    while (getline(iss, token, separator)) {
-        tokens.push_back(token);
+    template <typename Words, typename FilterWords>
+    void operator()(const Words& words, FilterWords& filterWords) const {
+        filter_words_into(words, terms, filterWords);
     }
-
-    transform(tokens.begin(), tokens.end(), std::back_inserter(splittedWords), [&](const std::string& token) {
-        string subString = remove_special_characters(token);
-
-        transform(subString.begin(), subString.end(), subString.begin(), [](unsigned char c) {
-            return tolower(c);
-        });
-
-        if (!subString.empty()) {
-            Word word{subString, index};
-            index += token.size() + 1; // Increment index by the size of the token plus 1 for the separator
-            return word;
-        } else {
-            return Word{};
-        }
-    });
-
-    return splittedWords;
-};
-
-auto split_book_into_chapters = [](const string& book) -> vector<string> {
-    regex chapter_regex(R"(CHAPTER \d+)");
-    sregex_token_iterator chapters_begin(book.begin(), book.end(), chapter_regex, -1);
-    sregex_token_iterator chapters_end;
-    vector<string> chapters(chapters_begin, chapters_end);
-    chapters.erase(chapters.begin());
-    return chapters;
-};
-
-auto filter_words = [](const vector<Word>& words, const vector<string>& filter) -> vector<Word> {
-    vector<Word> filterWords;
-
-    copy_if(words.begin(), words.end(), back_inserter(filterWords), [=](const Word& word){
-        return std::find_if(filter.begin(), filter.end(), [&](const std::string& filterWord) {
-            return filterWord == word.str;
-        }) != filter.end();
-    });
-
-    return filterWords;
 };
 
-auto calculate_wordCount = [](const map<string, vector<Word>>& wordMap) -> vector<WordCount> {
-    vector<WordCount> result;
-
-    for_each(wordMap.begin(), wordMap.end(), [&](const pair<string, vector<Word>>& pair){
-        int wordCount = pair.second.size();
-        WordCount current {pair.first, wordCount};
-        result.push_back(current);
-    });
-
-    return result;
+struct TermFilters {
+    TermFilter peace;
+    TermFilter war;
 };
 
-auto map_words = [](const vector<Word>& words) -> map<string, vector<Word>> {
-    map<string, vector<Word>> wordMap;
-    for_each(words.begin(), words.end(), [&wordMap](const Word& word) {
-        wordMap[word.str].push_back(word);
-    });
-    return wordMap;
+auto term_filters = [](vector<string> peaceTerms, vector<string> warTerms) -> TermFilters {
+    return TermFilters{TermFilter{std::move(peaceTerms)}, TermFilter{std::move(warTerms)}};
 };
 
-auto calculate_density = [](const vector<Word>& words) -> double {
-    if(words.size() < 2){
-        return -1.0;
-    }
-
-    double distanceSum = accumulate(words.begin(), words.end() - 1, 0.0, [](double sum, const Word& word){
-        auto next = &word + 1;
-        int distance = next->indexInText - word.indexInText;
-        return sum + distance;
-    });
-
-    return distanceSum / (words.size() - 1);
+// The filters of the book's term lists
+auto book_filters = []() -> TermFilters {
+    return term_filters(read_terms("./data/peace_terms.txt").value(), read_terms("./data/war_terms.txt").value());
 };
 
-auto get_relation_value = [](const vector<WordCount>& wordData, const double& density){
-    int sumCount = accumulate(wordData.begin(), wordData.end(), 0, [](const int accumulator, const WordCount& item){
-        return accumulator + item.count;
-    });
-
-    return sumCount + (200 - density);
-};
-
-/* auto process_chapter = [](const string& chapter) {
-    return [chapter](const auto& filterPeaceTerms, const auto& filterWarTerms) -> Relation {
-        auto chapter_words = tokenize(chapter, ' ');
-
-        auto warWords = filterWarTerms(chapter_words);
-        auto peaceWords = filterPeaceTerms(chapter_words);
-
-        auto warMap = map_words(warWords);
-        auto peaceMap = map_words(peaceWords);
-
-        auto warResult = calculate_wordCount(warMap);
-        auto peaceResult = calculate_wordCount(peaceMap);
-
-        auto warDensity = calculate_density(warWords);
-        auto peaceDensity = calculate_density(peaceWords);
-
-        int warRelationValue = get_relation_value(warResult, warDensity);
-        int peaceRelationValue = get_relation_value(peaceResult, peaceDensity);
-
-        return ((warRelationValue > peaceRelationValue) ? Relation::WAR : Relation::PEACE);
-    };
-}; */
-
 /* TEST_CASE("Process Chapter Test") {
     string chapter = "Once upon a time, there was a war. The war was long and hard. The war was won by the good guys. The good guys lived happily ever after.";
     vector<string> warTerms = {"war", "hard"};
@@ -396,4 +267,1562 @@ TEST_CASE("Remove Special Characters") {
     string expected = "Hello World This is a test";
     string actual = remove_special_characters(str);
     CHECK(expected == actual);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Read Terms strips CRLF") {
+    vector<string> expected = {"abundance", "agreement"};
+    vector<string> actual = read_terms("./data/peace_terms.txt").value();
+    actual.resize(2);
+    CHECK(expected == actual);
+}
+
+TEST_CASE("Within One Edit") {
+    CHECK(within_one_edit("battle", "battle"));
+    CHECK(within_one_edit("battle", "battel"));
+    CHECK(within_one_edit("battle", "batle"));
+    CHECK(within_one_edit("battle", "battles"));
+    CHECK(within_one_edit("battle", "bottle"));
+    CHECK_FALSE(within_one_edit("battle", "bottel"));
+    CHECK_FALSE(within_one_edit("battle", "bat"));
+}
+
+TEST_CASE("Deletion Index Lookup") {
+    auto index = build_deletion_index({"battle", "enemy", "war"});
+
+    CHECK(lookup_term(index, "battle") == optional<uint32_t>(0));
+    CHECK(lookup_term(index, "battel") == optional<uint32_t>(0));
+    CHECK(lookup_term(index, "batle") == optional<uint32_t>(0));
+    CHECK(lookup_term(index, "enemys") == optional<uint32_t>(1));
+    CHECK(lookup_term(index, "war") == optional<uint32_t>(2));
+    CHECK(lookup_term(index, "was") == nullopt);
+    CHECK(lookup_term(index, "cattle") == optional<uint32_t>(0));
+    CHECK(lookup_term(index, "peace") == nullopt);
+}
+
+TEST_CASE("Fuzzy Filter Words") {
+    vector<Word> words = {
+        {"the", 0},
+        {"battel", 4},
+        {"of", 11},
+        {"enemys", 14},
+        {"was", 21}
+    };
+
+    vector<Word> expected = {
+        {"battle", 4},
+        {"enemy", 14}
+    };
+
+    auto index = build_deletion_index({"battle", "enemy", "war"});
+    vector<Word> actual = fuzzy_filter_words(words, index);
+
+    CHECK(expected == actual);
+}
+
+TEST_CASE("Lexicon Registry keeps pinned versions alive") {
+    LexiconRegistry registry(build_lexicon_set({"peace"}, {"war"}));
+
+    optional<LexiconRegistry::Snapshot> first(registry.acquire());
+    atomic<bool> published{false};
+    thread publisher([&]() {
+        registry.publish(build_lexicon_set({"truce"}, {"battle"}));
+        published = true;
+    });
+
+    // the publisher has to wait for the snapshot of the first version
+    while(registry.current.load() == first->lexicons){
+        this_thread::yield();
+    }
+    CHECK((*first)->warTerms == vector<string>{"war"});
+    CHECK_FALSE(published.load());
+
+    {
+        auto second = registry.acquire();
+        CHECK(second->warTerms == vector<string>{"battle"});
+    }
+
+    first.reset();
+    publisher.join();
+    CHECK(published.load());
+    CHECK(registry.version() == 2);
+}
+
+TEST_CASE("Process All Chapters Live") {
+    LexiconRegistry registry(build_lexicon_set({"peace", "calm"}, {"war"}));
+    vector<string> chapters = {"war war peace and so on and so forth peace", "peace calm war and so on and so forth war"};
+
+    map<int, Relation> expected = {
+        {1, Relation::WAR},
+        {2, Relation::PEACE}
+    };
+
+    CHECK(expected == process_all_chapters_live(chapters, registry, false));
+    CHECK(expected == process_all_chapters_live(chapters, registry, true));
+}
+
+TEST_CASE("Compiled Lexicon Lookup") {
+    auto blob = compile_lexicon({"peace", "calm"}, {"war", "calm"});
+    auto lexicon = view_compiled_lexicon(blob.data(), blob.size(), nullptr);
+    REQUIRE(lexicon.has_value());
+
+    const CompiledTerm* peace = find_compiled_term(lexicon.value(), "peace");
+    REQUIRE(peace != nullptr);
+    CHECK(lexicon->spelling(*peace) == "peace");
+    CHECK(peace->categoryMask == category_bit(Relation::PEACE));
+    CHECK(peace->weight == 1.0f);
+
+    const CompiledTerm* calm = find_compiled_term(lexicon.value(), "calm");
+    REQUIRE(calm != nullptr);
+    CHECK(calm->categoryMask == (category_bit(Relation::PEACE) | category_bit(Relation::WAR)));
+    CHECK(calm->weight == defaultTermWeight);
+
+    CHECK(find_compiled_term(lexicon.value(), "battle") == nullptr);
+}
+
+TEST_CASE("Compiled Lexicon keeps lines with spaces whole like filter_words") {
+    const vector<string> peaceTerms = {"calm 2", "peace and quiet", "rest"};
+    const vector<string> warTerms = {"war"};
+    auto blob = compile_lexicon(peaceTerms, warTerms);
+    auto lexicon = view_compiled_lexicon(blob.data(), blob.size(), nullptr);
+    REQUIRE(lexicon.has_value());
+
+    CHECK(find_compiled_term(lexicon.value(), "calm 2") != nullptr);
+    CHECK(find_compiled_term(lexicon.value(), "calm") == nullptr);
+    CHECK(find_compiled_term(lexicon.value(), "peace") == nullptr);
+
+    // split on commas so a word can hold the spaces of a term line
+    auto words = tokenize("calm 2,calm,peace,peace and quiet,rest,war", ',');
+    CHECK(filter_words(words, peaceTerms) == compiled_filter_words(words, lexicon.value(), Relation::PEACE));
+    CHECK(filter_words(words, warTerms) == compiled_filter_words(words, lexicon.value(), Relation::WAR));
+    CHECK(compiled_filter_words(words, lexicon.value(), Relation::PEACE).size() == 3);
+}
+
+TEST_CASE("Compiled Lexicon rejects damaged blobs") {
+    auto blob = compile_lexicon({"peace"}, {"war"});
+    CHECK_FALSE(view_compiled_lexicon(blob.data(), blob.size() - 1, nullptr).has_value());
+    blob[0] = 'X';
+    CHECK_FALSE(view_compiled_lexicon(blob.data(), blob.size(), nullptr).has_value());
+
+    // written on a machine of the other byte order
+    auto swapped = compile_lexicon({"peace"}, {"war"});
+    const uint32_t otherOrder = 0x04030201;
+    memcpy(swapped.data() + offsetof(CompiledLexiconHeader, byteOrder), &otherOrder, sizeof(otherOrder));
+    CHECK_FALSE(view_compiled_lexicon(swapped.data(), swapped.size(), nullptr).has_value());
+}
+
+TEST_CASE("Compiled Lexicon lookups end on a table without empty slots") {
+    auto blob = compile_lexicon({"peace"}, {"war"});
+    CompiledLexiconHeader header;
+    memcpy(&header, blob.data(), sizeof(header));
+    // every slot points at the first term, so no probe sequence meets an empty slot
+    const uint32_t firstTerm = 1;
+    for(uint32_t slot = 0; slot < header.slotCount; slot++){
+        memcpy(blob.data() + header.slotsOffset + slot * sizeof(uint32_t), &firstTerm, sizeof(firstTerm));
+    }
+    auto lexicon = view_compiled_lexicon(blob.data(), blob.size(), nullptr);
+    REQUIRE(lexicon.has_value());
+    CHECK(find_compiled_term(lexicon.value(), "battle") == nullptr);
+    CHECK(find_compiled_term(lexicon.value(), "peace") != nullptr);
+}
+
+TEST_CASE("Compiled Filter Words matches filter_words") {
+    auto words = tokenize("The war was over and peace came, war never returned", ' ');
+    vector<string> peaceTerms = {"peace", "returned"};
+    vector<string> warTerms = {"war", "over"};
+
+    const string path = "./out/test_lexicon.bin";
+    REQUIRE(write_compiled_lexicon(path, compile_lexicon(peaceTerms, warTerms)));
+    auto lexicon = load_compiled_lexicon(path);
+    REQUIRE(lexicon.has_value());
+
+    CHECK(filter_words(words, peaceTerms) == compiled_filter_words(words, lexicon.value(), Relation::PEACE));
+    CHECK(filter_words(words, warTerms) == compiled_filter_words(words, lexicon.value(), Relation::WAR));
+}
+
+TEST_CASE("Generate Matcher Source") {
+    string source = generate_matcher_source({"peace"}, {"war", "peace"});
+
+    CHECK(source.find("case 3:") != string::npos);
+    CHECK(source.find("case 'w':") != string::npos);
+    CHECK(source.find("if(generated_load16(s + 1) == 0x7261u) return 1;") != string::npos);
+    CHECK(source.find("if(generated_load32(s + 1) == 0x65636165u) return 3;") != string::npos);
+}
+
+TEST_CASE("Generated Filter Words matches filter_words") {
+    auto peaceTerms = read_terms("./data/peace_terms.txt").value();
+    auto warTerms = read_terms("./data/war_terms.txt").value();
+    auto words = tokenize("The war was over, peace and harmony came; a soldier ate breakfast with the enemy", ' ');
+
+    CHECK(filter_words(words, peaceTerms) == generated_filter_words(words, Relation::PEACE));
+    CHECK(filter_words(words, warTerms) == generated_filter_words(words, Relation::WAR));
+    CHECK(generated_term_count == peaceTerms.size() + warTerms.size());
+}
+
+TEST_CASE("Find Chapter Ranges") {
+    string book = "Title CHAPTER 1 Once upon a time... CHAPTER 2 In a land far away...";
+
+    vector<ChapterRange> expected = {
+        {15, 36},
+        {45, book.size()}
+    };
+
+    CHECK(expected == find_chapter_ranges(book));
+}
+
+TEST_CASE("Find Chapter Ranges edge cases") {
+    // headings need a digit, adjacent headings give an empty chapter, a heading at the end gives none
+    CHECK(find_chapter_ranges("no chapters here").empty());
+    CHECK(find_chapter_ranges("CHAPTER 1").empty());
+    CHECK(find_chapter_ranges("CHAPTER x CHAPTER 12b") == vector<ChapterRange>{{20, 21}});
+    CHECK(find_chapter_ranges("x CHAPTER 1CHAPTER 2 b") == vector<ChapterRange>{{11, 11}, {20, 22}});
+    CHECK(find_chapter_ranges("CHAPTER 1 a CHAPTER 2") == vector<ChapterRange>{{9, 12}});
+    CHECK(find_chapter_ranges("CHAPTER 1 a CHAPTE") == vector<ChapterRange>{{9, 18}});
+}
+
+TEST_CASE("Split Book into Chapter Views") {
+    string book = "CHAPTER 1 Once upon a time... CHAPTER 2 In a land far away...";
+
+    vector<string_view> expected = {
+        " Once upon a time... ",
+        " In a land far away..."
+    };
+
+    vector<string_view> actual = split_book_into_chapter_views(book);
+
+    CHECK(expected == actual);
+    CHECK(actual[0].data() == book.data() + 9);
+}
+
+TEST_CASE("Tokenize keeps getline semantics") {
+    vector<Word> expected = {
+        {"a", 0},
+        {"", 0},
+        {"b", 2},
+        {"c", 4}
+    };
+
+    CHECK(expected == tokenize("a  b c ", ' '));
+    CHECK(tokenize("", ' ').empty());
+}
+
+TEST_CASE("Index Document") {
+    string text = "Header\r\n*** START OF THE BOOK ***\r\nBOOK ONE: 1805\r\n\r\nCHAPTER 1\r\nwar war\r\nCHAPTER 2\r\npeace\r\n"
+                  "FIRST EPILOGUE: 1813\r\nCHAPTER 1\r\nthe end\r\n*** END OF THE BOOK ***\r\nlicense\r\n";
+    auto index = index_document(text);
+
+    CHECK(text.substr(index.frontMatter.begin, index.frontMatter.end) == "Header\r\n*** START OF THE BOOK ***\r\n");
+    CHECK(text.substr(index.backMatter.begin) == "*** END OF THE BOOK ***\r\nlicense\r\n");
+
+    REQUIRE(index.parts.size() == 2);
+    CHECK(index.parts[0].kind == PartKind::BOOK);
+    CHECK(index.parts[0].title == "BOOK ONE: 1805");
+    CHECK(index.parts[0].firstChapter == 0);
+    CHECK(index.parts[0].chapterCount == 2);
+    CHECK(index.parts[1].kind == PartKind::EPILOGUE);
+    CHECK(index.parts[1].firstChapter == 2);
+    CHECK(index.parts[1].chapterCount == 1);
+    CHECK(index.parts[1].range.end == index.backMatter.begin);
+
+    vector<string_view> expected = {"\r\nwar war\r\n", "\r\npeace\r\n", "\r\nthe end\r\n"};
+    CHECK(expected == chapter_views(text, index));
+    const auto body = find_gutenberg_body(text);
+    CHECK(expected == chapter_views(string_view(text).substr(body.begin, body.end - body.begin), index, body.begin));
+    CHECK(index.chapters[2].number == 1);
+    CHECK(index.chapters[2].part == 1);
+
+    CHECK(chapter_at(index, index.chapters[1].range.begin + 3) == optional<size_t>(1));
+    CHECK(chapter_at(index, 0) == nullopt);
+}
+
+TEST_CASE("Index Document of data/book.txt") {
+    auto index = index_document(read_text("./data/book.txt").value());
+
+    CHECK(index.chapters.size() == 365);
+    REQUIRE(index.parts.size() == 17);
+    CHECK(index.parts[0].title == "BOOK ONE: 1805");
+    CHECK(index.parts[15].kind == PartKind::EPILOGUE);
+    CHECK(index.parts[16].title == "SECOND EPILOGUE");
+}
+
+TEST_CASE("Chapter At agrees with the chapter ranges at every offset") {
+    const string text = read_text("./data/book.txt").value();
+    auto index = index_document(text);
+    REQUIRE(index.blockShift >= minimumChapterBlockShift);
+
+    size_t wrong = 0;
+    size_t chapter = 0;
+    for(size_t offset = 0; offset < text.size() + 100; offset++){
+        while(chapter < index.chapters.size() && index.chapters[chapter].range.end <= offset){
+            chapter++;
+        }
+        const bool inside = chapter < index.chapters.size() && index.chapters[chapter].range.begin <= offset;
+        wrong += chapter_at(index, offset) == (inside ? optional<size_t>(chapter) : nullopt) ? 0 : 1;
+    }
+    CHECK(wrong == 0);
+}
+
+TEST_CASE("Flatten Lines matches Concatenate Lines") {
+    CHECK(flatten_lines("CHAPTER 1\r\nwar and\npeace\r\n") == concatenate_lines({"CHAPTER 1\r", "war and", "peace\r"}));
+}
+
+TEST_CASE("Summarize Parts") {
+    DocumentIndex index{{0, 0}, {0, 0}, {
+        {PartKind::BOOK, "BOOK ONE", {0, 0}, 0, 2},
+        {PartKind::EPILOGUE, "EPILOGUE", {0, 0}, 2, 1}
+    }, {}, 0, {}};
+    vector<ChapterSummary> chapters = {{3, 1, Relation::WAR}, {0, 2, Relation::PEACE}, {4, 0, Relation::WAR}};
+
+    auto parts = summarize_parts(index, chapters);
+
+    REQUIRE(parts.size() == 2);
+    CHECK(parts[0].warHits == 3);
+    CHECK(parts[0].peaceHits == 3);
+    CHECK(parts[0].warChapters == 1);
+    CHECK(parts[0].peaceChapters == 1);
+    CHECK(parts[1].warHits == 4);
+    CHECK(parts[1].warChapters == 1);
+}
+
+TEST_CASE("Find Gutenberg Body") {
+    string text = "Header\r\n*** START OF THE BOOK ***\r\nCHAPTER 1\r\nwar\r\n*** END OF THE BOOK ***\r\nEND OF license\r\n";
+    auto body = find_gutenberg_body(text);
+    CHECK(text.substr(body.begin, body.end - body.begin) == "\r\nCHAPTER 1\r\nwar\r\n");
+    CHECK(find_gutenberg_body(flatten_lines(text)) == body);
+
+    string plain = "CHAPTER 1 no markers";
+    CHECK(find_gutenberg_body(plain) == ChapterRange{0, plain.size()});
+}
+
+TEST_CASE("Find Gutenberg Body of data/book.txt") {
+    auto text = read_text("./data/book.txt").value();
+    auto body = find_gutenberg_body(text);
+    auto bodyText = string_view(text).substr(body.begin, body.end - body.begin);
+
+    CHECK(bodyText.find("Project Gutenberg") == string_view::npos);
+    CHECK(bodyText.find("BOOK ONE: 1805") != string_view::npos);
+    CHECK(split_book_into_chapter_views(bodyText).size() == 365);
+}
+
+TEST_CASE("Parse Section Pattern") {
+    auto pattern = parse_section_pattern("Part {digits}");
+    REQUIRE(pattern.has_value());
+    REQUIRE(pattern->size() == 6);
+    CHECK(pattern->at(0).bytes['P']);
+    CHECK_FALSE(pattern->at(0).repeat);
+    CHECK(pattern->at(5).bytes['7']);
+    CHECK(pattern->at(5).repeat);
+
+    CHECK(parse_section_pattern("\\{digits\\}")->size() == 8);
+    CHECK_FALSE(parse_section_pattern("").has_value());
+    CHECK_FALSE(parse_section_pattern("Part {numbers}").has_value());
+    CHECK_FALSE(parse_section_pattern("Part {digits").has_value());
+    CHECK_FALSE(parse_section_pattern("Part \\").has_value());
+}
+
+TEST_CASE("Section DFA matches headings") {
+    auto dfa = compile_section_patterns({
+        parse_section_pattern("Chapter {roman}").value(),
+        parse_section_pattern("CHAPTER THE {upper}").value(),
+        parse_section_pattern("Part {digits}").value()
+    });
+
+    CHECK(match_section_heading(dfa, "Chapter IV. The", 0) == optional<size_t>(10));
+    CHECK(match_section_heading(dfa, "CHAPTER THE FIRST", 0) == optional<size_t>(17));
+    CHECK(match_section_heading(dfa, "Part 12", 0) == optional<size_t>(7));
+    CHECK(match_section_heading(dfa, "Part two", 0) == nullopt);
+    CHECK(match_section_heading(dfa, "Chapter 4", 0) == nullopt);
+
+    string text = "Preface Part 1 one Chapter II two CHAPTER THE LAST three";
+    vector<string_view> expected = {" one ", " two ", " three"};
+    CHECK(expected == split_into_section_views(text, dfa));
+}
+
+TEST_CASE("Section search takes the first heading and the longest one starting there") {
+    auto dfa = compile_section_patterns({parse_section_pattern("AB").value(), parse_section_pattern("A{upper}!").value()});
+
+    string text = "xABCD!yAB AB!";
+    vector<string_view> expected = {"y", " "};
+    CHECK(expected == split_into_section_views(text, dfa));
+
+    // a class that keeps matching without ever finishing a heading, and one that finishes at the end
+    const string run(200000, 'A');
+    CHECK(find_section_ranges(run, dfa).empty());
+    CHECK(split_into_section_views("x" + run + "!tail", dfa) == vector<string_view>{"tail"});
+}
+
+TEST_CASE("Section DFA agrees with Find Chapter Ranges") {
+    auto text = flatten_lines(read_text("./data/book.txt").value());
+    auto dfa = compile_section_patterns({parse_section_pattern("CHAPTER {digits}").value()});
+
+    CHECK(find_section_ranges(text, dfa) == find_chapter_ranges(text));
+}
+
+TEST_CASE("Parse Chapter Selection") {
+    CHECK(parse_chapter_selection("7") == optional<pair<int, int>>({7, 7}));
+    CHECK(parse_chapter_selection("3..12") == optional<pair<int, int>>({3, 12}));
+    CHECK_FALSE(parse_chapter_selection("0").has_value());
+    CHECK_FALSE(parse_chapter_selection("12..3").has_value());
+    CHECK_FALSE(parse_chapter_selection("3..").has_value());
+    CHECK_FALSE(parse_chapter_selection("x").has_value());
+}
+
+TEST_CASE("Chapter Sidecar round trip") {
+    const string path = "./out/test_sidecar.chapters";
+    ChapterSidecar sidecar{{100, 42}, {{10, 20}, {25, 90}}};
+    REQUIRE(write_chapter_sidecar(path, sidecar));
+
+    auto loaded = read_chapter_sidecar(path);
+    REQUIRE(loaded.has_value());
+    CHECK(loaded->book == sidecar.book);
+    CHECK(loaded->chapters == sidecar.chapters);
+
+    CHECK_FALSE(read_chapter_sidecar("./out/missing.chapters").has_value());
+}
+
+TEST_CASE("Chapter Selection reads the same chapters as the whole book") {
+    const string bookPath = "./data/book.txt";
+    auto chapterRanges = load_chapter_ranges(bookPath, "./out/test_book.chapters");
+    REQUIRE(chapterRanges.has_value());
+    REQUIRE(chapterRanges->size() == 365);
+    // the second load comes from the sidecar
+    CHECK(load_chapter_ranges(bookPath, "./out/test_book.chapters") == chapterRanges);
+
+    auto text = read_text(bookPath).value();
+    auto body = find_gutenberg_body(text);
+    auto chapters = split_book_into_chapter_views(flatten_lines(text.substr(body.begin, body.end - body.begin)));
+    CHECK(read_text_range(bookPath, chapterRanges->at(41)) == string(chapters[41]));
+
+    vector<string> peaceTerms = read_terms("./data/peace_terms.txt").value();
+    vector<string> warTerms = read_terms("./data/war_terms.txt").value();
+    auto filterPeaceTerms = bind(filter_words, placeholders::_1, peaceTerms);
+    auto filterWarTerms = bind(filter_words, placeholders::_1, warTerms);
+    auto selected = process_chapter_selection(bookPath, chapterRanges.value(), {363, 365})(filterPeaceTerms, filterWarTerms);
+    REQUIRE(selected.has_value());
+    CHECK(selected->size() == 3);
+    CHECK(selected->at(364) == process_chapter(chapters[363])(filterPeaceTerms, filterWarTerms));
+
+    CHECK_FALSE(process_chapter_selection(bookPath, chapterRanges.value(), {365, 366})(filterPeaceTerms, filterWarTerms).has_value());
+}
+
+TEST_CASE("Chapter Arena grows to the largest chapter") {
+    ChapterArena arena(64);
+
+    pmr::vector<int> first(arena.resource());
+    first.resize(100);
+    CHECK(arena.overflow.bytes > 0);
+    first = pmr::vector<int>(arena.resource());
+    arena.reset();
+
+    CHECK(arena.buffer.size() > 64);
+    CHECK(arena.overflow.bytes == 0);
+    pmr::vector<int> second(arena.resource());
+    second.resize(100);
+    CHECK(arena.overflow.bytes == 0);
+}
+
+TEST_CASE("Apply Filter accepts both filter shapes") {
+    pmr::vector<Word> words;
+    tokenize_into("war and peace", ' ', words);
+    vector<string> terms = {"war"};
+    vector<Word> expected = {{"war", 0}};
+
+    pmr::vector<Word> appended;
+    apply_filter(bind(filter_words_into, placeholders::_1, cref(terms), placeholders::_2), words, appended);
+    CHECK(expected == vector<Word>(appended.begin(), appended.end()));
+
+    pmr::vector<Word> returned;
+    apply_filter(bind(filter_words, placeholders::_1, cref(terms)), words, returned);
+    CHECK(expected == vector<Word>(returned.begin(), returned.end()));
+}
+
+TEST_CASE("Summarize Chapter in an arena") {
+    string chapter = "war war peace and so on and so forth peace";
+    vector<string> peaceTerms = {"peace"};
+    vector<string> warTerms = {"war"};
+    auto filterPeaceTerms = bind(filter_words_into, placeholders::_1, cref(peaceTerms), placeholders::_2);
+    auto filterWarTerms = bind(filter_words_into, placeholders::_1, cref(warTerms), placeholders::_2);
+
+    ChapterArena arena;
+    auto summary = summarize_chapter_with(chapter, arena.resource())(filterPeaceTerms, filterWarTerms);
+
+    CHECK(summary.warHits == 2);
+    CHECK(summary.peaceHits == 2);
+    CHECK(summary.relation == Relation::WAR);
+    CHECK(summary.relation == process_chapter(chapter)(bind(filter_words, placeholders::_1, peaceTerms), bind(filter_words, placeholders::_1, warTerms)));
+}
+
+TEST_CASE("Tokenize Block") {
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block("War and  peace, and war!", ' ', dictionary, block);
+
+    vector<Word> words = tokenize("War and  peace, and war!", ' ');
+    vector<Word> expected;
+    copy_if(words.begin(), words.end(), back_inserter(expected), [](const Word& word) { return !word.str.empty(); });
+
+    REQUIRE(block.size() == expected.size());
+    for (size_t i = 0; i < block.size(); i++) {
+        CHECK(dictionary.term(block.termIds[i]) == expected[i].str);
+        CHECK(int(block.positions[i]) == expected[i].indexInText);
+    }
+    CHECK(dictionary.size() == 3);
+    CHECK(block.termIds[0] == block.termIds[4]);
+    CHECK(reinterpret_cast<uintptr_t>(block.termIds.data()) % cacheLineSize == 0);
+    CHECK(reinterpret_cast<uintptr_t>(block.positions.data()) % cacheLineSize == 0);
+}
+
+TEST_CASE("Filter Block matches Filter Words") {
+    string chapter = "the war began and the peace ended the war";
+    vector<string> terms = {"war", "peace"};
+
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block(chapter, ' ', dictionary, block);
+    pmr::vector<uint8_t> matches;
+    classify_terms(bind(filter_words, placeholders::_1, terms), dictionary, matches);
+    TokenBlock filtered;
+    filter_block_into(block, matches, filtered);
+
+    vector<Word> words = filter_words(tokenize(chapter, ' '), terms);
+    REQUIRE(filtered.size() == words.size());
+    for (size_t i = 0; i < filtered.size(); i++) {
+        CHECK(int(filtered.positions[i]) == words[i].indexInText);
+    }
+    CHECK(calculate_block_density(filtered) == calculate_density(words));
+
+    TermTable counts;
+    count_block_terms_into(filtered, counts);
+    CHECK(get_block_relation_value(counts, calculate_block_density(filtered)) ==
+          get_relation_value(calculate_wordCount(map_words(words)), calculate_density(words)));
+}
+
+TEST_CASE("Calculate Block Density of fewer than two tokens") {
+    TokenBlock block;
+    CHECK(calculate_block_density(block) == -1.0);
+    block.push_back(0, 10);
+    CHECK(calculate_block_density(block) == -1.0);
+}
+
+// The positions on the chain of an entry of the table
+auto term_positions = [](const TermTable& table, const TermEntry& entry, const TokenBlock& block) -> vector<uint32_t> {
+    vector<uint32_t> positions;
+    for (uint32_t token = entry.head; token != noTerm; token = table.next[token]) {
+        positions.push_back(block.positions[token]);
+    }
+    return positions;
+};
+
+TEST_CASE("Term Table counts like Map Words") {
+    string chapter = "peace war and war peace war";
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block(chapter, ' ', dictionary, block);
+    TermTable table;
+    count_block_terms_into(block, table);
+
+    CHECK(sorted_word_counts(table, dictionary) == calculate_wordCount(map_words(tokenize(chapter, ' '))));
+
+    uint32_t war = block.termIds[1];
+    const TermEntry& entry = table.entries[table.find(war).value()];
+    CHECK(entry.count == 3);
+    CHECK(term_positions(table, entry, block) == vector<uint32_t>{6, 14, 24});
+    CHECK_FALSE(table.find(uint32_t(dictionary.size())).has_value());
+}
+
+TEST_CASE("Term Table keeps every entry when it grows") {
+    TokenBlock block;
+    for (uint32_t i = 0; i < 1000; i++) {
+        block.push_back(i % 100 * 7919, i);
+    }
+    TermTable table;
+    count_block_terms_into(block, table);
+
+    CHECK(table.size == 100);
+    CHECK(table.entries.size() >= 128);
+    for (uint32_t termId = 0; termId < 100; termId++) {
+        auto slot = table.find(termId * 7919);
+        REQUIRE(slot.has_value());
+        CHECK(table.entries[slot.value()].count == 10);
+        CHECK(term_positions(table, table.entries[slot.value()], block).front() == termId);
+        CHECK(term_positions(table, table.entries[slot.value()], block).back() == 900 + termId);
+    }
+}
+
+TEST_CASE("Category Hits give the density of the full positions") {
+    vector<Word> words = {{"war", 3}, {"war", 10}, {"war", 40}};
+    CategoryHits hits;
+    for (const Word& word : words) {
+        hits.add(word.indexInText);
+    }
+    CHECK(hits.count == 3);
+    CHECK(hits.first == 3);
+    CHECK(hits.last == 40);
+    CHECK(calculate_hits_density(hits) == calculate_density(words));
+    CHECK(calculate_hits_density(CategoryHits{}) == -1.0);
+}
+
+TEST_CASE("Count-only and verbose scoring agree") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    const auto filters = book_filters();
+
+    for (size_t i = 0; i < chapters.size(); i += 10) {
+        auto summary = summarize_chapter(chapters[i])(filters.peace, filters.war);
+        auto detail = detail_chapter(chapters[i])(filters.peace, filters.war);
+        CHECK(summary.relation == detail.summary.relation);
+        CHECK(summary.warHits == detail.summary.warHits);
+        CHECK(summary.peaceHits == detail.summary.peaceHits);
+    }
+}
+
+TEST_CASE("Detail Chapter counts every term") {
+    string chapter = "war war peace and so on and so forth peace battle";
+    vector<string> peaceTerms = {"peace"};
+    vector<string> warTerms = {"war", "battle"};
+    auto detail = detail_chapter(chapter)(bind(filter_words, placeholders::_1, peaceTerms), bind(filter_words, placeholders::_1, warTerms));
+
+    CHECK(detail.summary.warHits == 3);
+    CHECK(detail.warCounts == vector<WordCount>{{"battle", 1}, {"war", 2}});
+    CHECK(detail.peaceCounts == vector<WordCount>{{"peace", 2}});
+    REQUIRE(detail.warPositions.size() == 2);
+    CHECK(decode_positions(detail.warPositions.list(0)) == vector<uint32_t>{43});
+    CHECK(decode_positions(detail.warPositions.list(1)) == vector<uint32_t>{0, 4});
+    CHECK(decode_positions(detail.peacePositions.list(0)) == vector<uint32_t>{8, 37});
+}
+
+TEST_CASE("Position List round trip") {
+    vector<uint32_t> positions;
+    uint32_t position = 0;
+    for (uint32_t i = 0; i < 1000; i++) {
+        position += (i % 7 == 0) ? 70000 + i : (i % 3 == 0) ? 300 : 5;
+        positions.push_back(position);
+    }
+    positions.push_back(0xF0000000u);
+
+    PositionList list;
+    for (uint32_t p : positions) {
+        list.push_back(p);
+    }
+
+    CHECK(list.size() == positions.size());
+    CHECK(list.skips.size() == 7);
+    CHECK(decode_positions(list.view()) == positions);
+    CHECK(list.bytes.size() < positions.size() * sizeof(uint32_t));
+}
+
+TEST_CASE("Position List skips to a position") {
+    PositionList list;
+    for (uint32_t i = 1; i <= 1000; i++) {
+        list.push_back(i * 10);
+    }
+
+    CHECK(skip_to(list.view(), 0) == 10u);
+    CHECK(skip_to(list.view(), 10) == 10u);
+    CHECK(skip_to(list.view(), 11) == 20u);
+    CHECK(skip_to(list.view(), 1280) == 1280u);
+    CHECK(skip_to(list.view(), 1281) == 1290u);
+    CHECK(skip_to(list.view(), 9995) == 10000u);
+    CHECK_FALSE(skip_to(list.view(), 10001).has_value());
+    CHECK_FALSE(skip_to(PositionList{}.view(), 0).has_value());
+}
+
+TEST_CASE("Build Position Index") {
+    string text = "the war and the peace and the war";
+    TermDictionary dictionary;
+    TokenBlock block;
+    tokenize_block(text, ' ', dictionary, block);
+    auto index = build_position_index(block, dictionary.size());
+
+    map<string, vector<Word>> words = map_words(tokenize(text, ' '));
+    REQUIRE(index.size() == words.size());
+    for (uint32_t termId = 0; termId < dictionary.size(); termId++) {
+        vector<uint32_t> expected;
+        for (const Word& word : words[string(dictionary.term(termId))]) {
+            expected.push_back(word.indexInText);
+        }
+        CHECK(decode_positions(index.list(termId)) == expected);
+    }
+
+    TokenBlock repeated;
+    for (uint32_t i = 0; i < 1000; i++) {
+        repeated.push_back(i % 2, i * 3);
+    }
+    auto large = build_position_index(repeated, 2);
+    CHECK(large.list(0).skipCount == 3);
+    CHECK(skip_to(large.list(1), 1500) == 1503u);
+    CHECK(decode_positions(large.list(1)).back() == 2997u);
+}
+
+TEST_CASE("Process All Chapters numbers every call from 1") {
+    vector<string> chapters = {"war war peace and so on and so forth peace", "peace calm war and so on and so forth war"};
+    vector<string> peaceTerms = {"peace", "calm"};
+    vector<string> warTerms = {"war"};
+    auto filterPeaceTerms = bind(filter_words, placeholders::_1, peaceTerms);
+    auto filterWarTerms = bind(filter_words, placeholders::_1, warTerms);
+
+    map<int, Relation> expected = {
+        {1, Relation::WAR},
+        {2, Relation::PEACE}
+    };
+    CHECK(expected == process_all_chapters(chapters)(filterPeaceTerms, filterWarTerms));
+    CHECK(expected == process_all_chapters(chapters)(filterPeaceTerms, filterWarTerms));
+}
+
+TEST_CASE("Thread Pool runs every task") {
+    ThreadPool pool(4);
+    CHECK(pool.size() == 4);
+    atomic<int> sum{0};
+    for (int i = 1; i <= 100; i++) {
+        pool.submit([&sum, i]() { sum += i; });
+    }
+    pool.wait();
+    CHECK(sum == 5050);
+
+    pool.submit([&sum]() { sum = 0; });
+    pool.wait();
+    CHECK(sum == 0);
+}
+
+TEST_CASE("Parallel chapters give the serial result") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    const auto filters = book_filters();
+
+    auto serial = process_all_chapters(chapters)(filters.peace, filters.war);
+    for (size_t threads : {1, 3, 8}) {
+        ThreadPool pool(threads);
+        CHECK(serial == process_all_chapters_parallel(chapters, pool)(filters.peace, filters.war));
+    }
+}
+
+TEST_CASE("Chase-Lev Deque") {
+    ChaseLevDeque deque(2);
+    for (int64_t task = 0; task < 10; task++) {
+        deque.push(task);
+    }
+    CHECK(deque.steal() == 0);
+    CHECK(deque.take() == 9);
+    CHECK(deque.steal() == 1);
+
+    vector<int64_t> rest;
+    for (int64_t task = deque.take(); task != ChaseLevDeque::empty; task = deque.take()) {
+        rest.push_back(task);
+    }
+    CHECK(rest == vector<int64_t>{8, 7, 6, 5, 4, 3, 2});
+    CHECK(deque.steal() == ChaseLevDeque::empty);
+}
+
+TEST_CASE("Chase-Lev Deque hands out every task once") {
+    ChaseLevDeque deque;
+    const int64_t taskCount = 20000;
+    vector<atomic<int>> seen(taskCount);
+    atomic<bool> done{false};
+
+    vector<thread> thieves;
+    for (int i = 0; i < 3; i++) {
+        thieves.emplace_back([&]() {
+            while (!done) {
+                int64_t task = deque.steal();
+                if (task != ChaseLevDeque::empty) {
+                    seen[task]++;
+                }
+            }
+        });
+    }
+    for (int64_t task = 0; task < taskCount; task++) {
+        deque.push(task);
+        if (task % 3 == 0) {
+            int64_t taken = deque.take();
+            if (taken != ChaseLevDeque::empty) {
+                seen[taken]++;
+            }
+        }
+    }
+    for (int64_t task = deque.take(); task != ChaseLevDeque::empty; task = deque.take()) {
+        seen[task]++;
+    }
+    done = true;
+    for (thread& thief : thieves) {
+        thief.join();
+    }
+
+    CHECK(all_of(seen.begin(), seen.end(), [](const atomic<int>& count) { return count == 1; }));
+}
+
+TEST_CASE("Merged pieces give the hits of the whole chapter") {
+    string chapter = "war  war peace, and so on  and so forth peace war";
+    const auto filters = term_filters({"peace"}, {"war"});
+
+    auto whole = partial_summary(chapter)(filters.peace, filters.war);
+    for (size_t split = chapter.find(' '); split != string::npos; split = chapter.find(' ', split + 1)) {
+        auto left = partial_summary(string_view(chapter).substr(0, split))(filters.peace, filters.war);
+        auto right = partial_summary(string_view(chapter).substr(split + 1))(filters.peace, filters.war);
+        CHECK(merge_partials(left, right) == whole);
+    }
+}
+
+TEST_CASE("Work stealing gives the serial result") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    const auto filters = book_filters();
+
+    vector<ChapterSummary> serial;
+    for (const string_view chapter : chapters) {
+        serial.push_back(summarize_chapter(chapter)(filters.peace, filters.war));
+    }
+
+    for (size_t threads : {1, 4}) {
+        auto run = summarize_all_chapters_stealing(chapters, threads, 1000)(filters.peace, filters.war);
+        REQUIRE(run.summaries.size() == serial.size());
+        for (size_t i = 0; i < serial.size(); i++) {
+            CHECK(run.summaries[i].relation == serial[i].relation);
+            CHECK(run.summaries[i].warHits == serial[i].warHits);
+            CHECK(run.summaries[i].peaceHits == serial[i].peaceHits);
+        }
+        CHECK(run.workers.size() == threads);
+        size_t ranges = 0;
+        size_t splits = 0;
+        for (const WorkerStats& worker : run.workers) {
+            ranges += worker.ranges;
+            splits += worker.splits;
+        }
+        CHECK(splits > 0);
+        CHECK(ranges == chapters.size() + splits);
+    }
+
+    // every worker is started on a thread of its own, as when they are pinned
+    mutex startedMutex;
+    set<size_t> started;
+    const auto caller = this_thread::get_id();
+    bool onCaller = false;
+    auto run = summarize_all_chapters_stealing(chapters, 3, 1000, [&](const size_t worker) {
+        lock_guard lock(startedMutex);
+        started.insert(worker);
+        onCaller = onCaller || this_thread::get_id() == caller;
+    })(filters.peace, filters.war);
+    CHECK(started == set<size_t>{0, 1, 2});
+    CHECK_FALSE(onCaller);
+    REQUIRE(run.summaries.size() == serial.size());
+    CHECK(run.summaries.back().relation == serial.back().relation);
+}
+
+TEST_CASE("Idle stealing workers sleep while one range is busy") {
+    const vector<string> terms{"war"};
+    auto filterTerms = bind(filter_words_into, placeholders::_1, cref(terms), placeholders::_2);
+    auto slowFilter = [&](const auto& words, auto& filterWords) {
+        for (const Word& word : words) {
+            if (word.str == "slow") {
+                this_thread::sleep_for(chrono::milliseconds(200));
+            }
+        }
+        filter_words_into(words, terms, filterWords);
+    };
+    const vector<string_view> chapters{"slow war", "war", "peace"};
+
+    const clock_t before = clock();
+    auto run = summarize_all_chapters_stealing(chapters, 4, 1000)(filterTerms, slowFilter);
+    const double processMilliseconds = 1000.0 * double(clock() - before) / CLOCKS_PER_SEC;
+    REQUIRE(run.summaries.size() == 3);
+    CHECK(run.summaries[0].warHits == 1);
+    // three workers spinning through the wait would take several times the wait in processor time
+    CHECK(processMilliseconds < 50);
+}
+
+TEST_CASE("Merge Partials is associative with an identity") {
+    mt19937 random(7);
+    auto random_partial = [&random]() {
+        ChapterPartial partial;
+        partial.span = 1000 + random() % 1000;
+        for (uint32_t position = random() % 50; position < partial.span; position += 1 + random() % 200) {
+            (random() % 2 ? partial.war : partial.peace).add(position);
+        }
+        return partial;
+    };
+
+    for (int i = 0; i < 200; i++) {
+        auto a = random_partial();
+        auto b = random_partial();
+        auto c = random_partial();
+        CHECK(merge_partials(merge_partials(a, b), c) == merge_partials(a, merge_partials(b, c)));
+        CHECK(merge_partials(ChapterPartial{}, a) == a);
+        CHECK(merge_partials(a, ChapterPartial{}) == a);
+    }
+}
+
+TEST_CASE("Merge order of the pieces of a chapter does not change the result") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    string_view chapter = split_book_into_chapter_views(book)[40];
+    const auto filters = book_filters();
+    const auto whole = partial_summary(chapter)(filters.peace, filters.war);
+
+    mt19937 random(11);
+    for (size_t pieceSize : {50, 300, 2000}) {
+        vector<ChapterPartial> pieces;
+        for_each_piece(chapter, pieceSize, ' ', [&](const string_view piece) {
+            pieces.push_back(partial_summary(piece)(filters.peace, filters.war));
+        });
+        REQUIRE(pieces.size() > 1);
+
+        auto leftFold = accumulate(pieces.begin(), pieces.end(), ChapterPartial{}, merge_partials);
+        auto rightFold = accumulate(pieces.rbegin(), pieces.rend(), ChapterPartial{}, [](const ChapterPartial& right, const ChapterPartial& left) {
+            return merge_partials(left, right);
+        });
+        PartialReduction reduction;
+        for (const ChapterPartial& piece : pieces) {
+            reduction.add(piece);
+        }
+        CHECK(leftFold == whole);
+        CHECK(rightFold == whole);
+        CHECK(reduction.result() == whole);
+
+        // random groupings: merge a random neighbouring pair until one partial is left
+        for (int round = 0; round < 5; round++) {
+            vector<ChapterPartial> remaining = pieces;
+            while (remaining.size() > 1) {
+                size_t i = random() % (remaining.size() - 1);
+                remaining[i] = merge_partials(remaining[i], remaining[i + 1]);
+                remaining.erase(remaining.begin() + i + 1);
+            }
+            CHECK(remaining.front() == whole);
+        }
+    }
+}
+
+TEST_CASE("For Each Piece splits at separators") {
+    vector<string> pieces;
+    for_each_piece("aaa bbb ccc dddddddd e", 5, ' ', [&](const string_view piece) { pieces.emplace_back(piece); });
+    CHECK(pieces == vector<string>{"aaa", "bbb", "ccc", "dddddddd", "e"});
+
+    pieces.clear();
+    for_each_piece("abcdefgh", 3, ' ', [&](const string_view piece) { pieces.emplace_back(piece); });
+    CHECK(pieces == vector<string>{"abcdefgh"});
+}
+
+TEST_CASE("SPSC ring keeps the order of a producer thread") {
+    SpscRing<int> ring(8);
+    const int count = 100000;
+    thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            ring.push(i);
+        }
+        ring.close();
+    });
+
+    vector<int> received;
+    int value;
+    while (ring.pop(value)) {
+        received.push_back(value);
+    }
+    producer.join();
+
+    vector<int> expected(count);
+    iota(expected.begin(), expected.end(), 0);
+    CHECK(received == expected);
+}
+
+TEST_CASE("MPMC ring hands every value to exactly one consumer") {
+    MpmcRing<int> ring(16);
+    const int perProducer = 20000;
+    atomic<int> running{4};
+    vector<thread> producers;
+    for (int p = 0; p < 4; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                ring.push(p * perProducer + i);
+            }
+            if (running.fetch_sub(1) == 1) {
+                ring.close();
+            }
+        });
+    }
+
+    vector<vector<int>> received(4);
+    vector<thread> consumers;
+    for (int c = 0; c < 4; c++) {
+        consumers.emplace_back([&, c]() {
+            int value;
+            while (ring.pop(value)) {
+                received[c].push_back(value);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    vector<int> all;
+    size_t outOfOrder = 0;
+    for (const auto& values : received) {
+        // values of one producer leave the ring in the order they were pushed
+        for (size_t i = 1; i < values.size(); i++) {
+            outOfOrder += values[i] / perProducer == values[i - 1] / perProducer && values[i] < values[i - 1];
+        }
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    CHECK(outOfOrder == 0);
+    sort(all.begin(), all.end());
+    vector<int> expected(4 * perProducer);
+    iota(expected.begin(), expected.end(), 0);
+    CHECK(all == expected);
+}
+
+TEST_CASE("Rings wake a side that went to sleep on a full or empty ring") {
+    // the other side only moves after both rings have been waited on for much longer than the spins
+    SpscRing<int> spsc(2);
+    MpmcRing<int> mpmc(2);
+    thread consumer([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        int value;
+        while (spsc.pop(value)) {
+        }
+        while (mpmc.pop(value)) {
+        }
+    });
+    for (int i = 0; i < 4; i++) {
+        spsc.push(i);
+    }
+    spsc.close();
+    for (int i = 0; i < 4; i++) {
+        mpmc.push(i);
+    }
+    mpmc.close();
+    consumer.join();
+    CHECK(spsc.full_waits() >= 1);
+    CHECK(mpmc.full_waits() >= 1);
+
+    SpscRing<int> empty(2);
+    int value = 0;
+    thread producer([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        empty.push(7);
+        this_thread::sleep_for(chrono::milliseconds(50));
+        empty.close();
+    });
+    CHECK(empty.pop(value));
+    CHECK(value == 7);
+    CHECK_FALSE(empty.pop(value));
+    producer.join();
+}
+
+TEST_CASE("Chapter boundary detector finds the chapters of the whole text in any block size") {
+    auto chapters_in_blocks = [](const string_view text, const size_t blockSize) {
+        ChapterBoundaryDetector detector;
+        vector<string> chapters;
+        auto collect = [&chapters](string chapter) { chapters.push_back(std::move(chapter)); };
+        for (size_t i = 0; i < text.size(); i += blockSize) {
+            detector.feed(text.substr(i, blockSize), collect);
+        }
+        detector.finish(collect);
+        return chapters;
+    };
+    auto chapters_at_once = [](const string_view text) {
+        const auto body = find_gutenberg_body(text);
+        return split_book_into_chapters(flatten_lines(string(text.substr(body.begin, body.end - body.begin))));
+    };
+
+    const string book = read_text("./data/book.txt").value();
+    const auto expected = chapters_at_once(book);
+    REQUIRE(expected.size() == 365);
+    for (size_t blockSize : {4096, 65536, 1 << 22}) {
+        CHECK(chapters_in_blocks(book, blockSize) == expected);
+    }
+
+    for (const string text : {"CHAPTER 1\nfirst CHAPTER\n2 second CHAPTER 3", "no markers CHAPTER 12 one CHAPTER 13",
+                              "header\n*** START OF THE BOOK ***\nCHAPTER 1 a\n*** END OF x\nCHAPTER 2 b\n*** END OF THE BOOK\nlicense CHAPTER 3",
+                              "*** START OF\nCHAPTER 1 text without an end marker CHAPTER 2", "*** START OF CHAPTER 1 cut"}) {
+        for (size_t blockSize : {1, 2, 3, 5, 100}) {
+            CHECK(chapters_in_blocks(text, blockSize) == chapters_at_once(text));
+        }
+    }
+}
+
+TEST_CASE("Chapter boundary detector hands on chapters of a book without a START marker before its end") {
+    string book = "Title\nCHAPTER 1\n";
+    for (int line = 0; line < 2000; line++) {
+        book += "a long line of the first chapter without any marker\n";
+    }
+    book += "CHAPTER 2\nsecond\nCHAPTER 3\nthird\n";
+    const auto body = find_gutenberg_body(book);
+    const auto expected = split_book_into_chapters(flatten_lines(book.substr(body.begin, body.end - body.begin)));
+    REQUIRE(expected.size() == 3);
+
+    ChapterBoundaryDetector detector;
+    vector<string> chapters;
+    auto collect = [&chapters](string chapter) { chapters.push_back(std::move(chapter)); };
+    for (size_t i = 0; i < book.size(); i += 4096) {
+        detector.feed(string_view(book).substr(i, 4096), collect);
+    }
+    // the third chapter may still go on, the first two are complete
+    CHECK(chapters.size() == 2);
+    detector.finish(collect);
+    CHECK(chapters == expected);
+}
+
+TEST_CASE("Pipeline emits every chapter in order with the relation of the batch path") {
+    const auto filters = book_filters();
+
+    string book = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(book);
+    const auto bodyText = flatten_lines(book.substr(body.begin, body.end - body.begin));
+    const auto expected = process_all_chapters(split_book_into_chapter_views(bodyText))(filters.peace, filters.war);
+
+    for (size_t workers : {1, 3}) {
+        map<int, Relation> emitted;
+        int lastNumber = 0;
+        auto collect = [&](const int number, const ChapterSummary& summary) {
+            CHECK(number == lastNumber + 1);
+            lastNumber = number;
+            emitted[number] = summary.relation;
+        };
+        auto stats = stream_chapters("./data/book.txt", workers, 2, collect)(filters.peace, filters.war);
+        REQUIRE(stats.has_value());
+        CHECK(stats->chapters == expected.size());
+        CHECK(stats->bytesRead == book.size());
+        CHECK(stats->firstChapterMilliseconds <= stats->totalMilliseconds);
+        CHECK(stats->peakReordered <= 2);
+        CHECK(emitted == expected);
+    }
+    CHECK_FALSE(stream_chapters("./data/missing.txt", 1, defaultReorderWindow, [](int, const ChapterSummary&) {})(filters.peace, filters.war).has_value());
+}
+
+TEST_CASE("Parallel transform writes every result to its own slot") {
+    vector<int> input(10000);
+    iota(input.begin(), input.end(), 0);
+    vector<long> output(input.size());
+    parallel_transform(input, output, [](const int value) { return long(value) * value; });
+
+    vector<long> expected(input.size());
+    transform(input.begin(), input.end(), expected.begin(), [](const int value) { return long(value) * value; });
+    CHECK(output == expected);
+
+    vector<int> none;
+    vector<long> noOutput;
+    parallel_transform(none, noOutput, [](const int value) { return long(value); });
+    CHECK(noOutput.empty());
+}
+
+TEST_CASE("Number Chapters counts from one") {
+    auto numbered = number_chapters({Relation::WAR, Relation::PEACE, Relation::PEACE});
+    CHECK(numbered == map<int, Relation>{{1, Relation::WAR}, {2, Relation::PEACE}, {3, Relation::PEACE}});
+    CHECK(number_chapters({}).empty());
+}
+
+TEST_CASE("Chapters on the parallel algorithms get the relations of the serial transform") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    const auto filters = book_filters();
+
+    const auto serial = process_all_chapters(chapters)(filters.peace, filters.war);
+    CHECK(serial.size() == 365);
+    CHECK(process_all_chapters_parallel_stl(chapters)(filters.peace, filters.war) == serial);
+    // a second run numbers from one again
+    CHECK(process_all_chapters(chapters)(filters.peace, filters.war) == serial);
+}
+
+TEST_CASE("Term count shard counts the tokens of tokenize") {
+    const string chapter = "The war, the PEACE and the war again!  War";
+    TermCountShard shard;
+    count_chapter_terms_into(chapter, shard);
+    count_chapter_terms_into("war", shard);
+
+    map<string, int> expected;
+    for (const Word& word : tokenize(chapter, ' ')) {
+        if (!word.str.empty()) {
+            expected[word.str]++;
+        }
+    }
+    expected["war"]++;
+
+    map<string, int> counted;
+    for (const CorpusWordCount& count : corpus_word_counts(shard, 0)) {
+        counted[count.word] = int(count.count);
+    }
+    CHECK(counted == expected);
+    CHECK(shard.total() == 10);
+}
+
+TEST_CASE("Merged shards count like one shard over every chapter") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    chapters.resize(40);
+
+    TermCountShard single;
+    for (const string_view chapter : chapters) {
+        count_chapter_terms_into(chapter, single);
+    }
+    const auto expected = corpus_word_counts(single, 0);
+    REQUIRE(expected.size() > 1000);
+
+    for (size_t threads : {1, 2, 3, 5, 8}) {
+        ThreadPool pool(threads);
+        const auto corpus = count_corpus_terms(chapters, pool);
+        CHECK(corpus.total() == single.total());
+        CHECK(corpus_word_counts(corpus, 0) == expected);
+    }
+
+    // shards that interned the same terms in another order
+    vector<TermCountShard> shards(3);
+    for (size_t i = 0; i < chapters.size(); i++) {
+        count_chapter_terms_into(chapters[chapters.size() - 1 - i], shards[i % 3]);
+    }
+    ThreadPool pool(2);
+    CHECK(corpus_word_counts(reduce_shards(shards, pool), 0) == expected);
+}
+
+TEST_CASE("Corpus word counts are ordered by frequency, then by word") {
+    TermCountShard shard;
+    count_chapter_terms_into("b a c b a d b", shard);
+    CHECK(corpus_word_counts(shard, 2) == vector<CorpusWordCount>{{"b", 3}, {"a", 2}});
+    CHECK(corpus_word_counts(shard, 0) == vector<CorpusWordCount>{{"b", 3}, {"a", 2}, {"c", 1}, {"d", 1}});
+    CHECK(corpus_word_counts(shard, 10).size() == 4);
+    TermCountShard empty;
+    CHECK(corpus_word_counts(empty, 5).empty());
+}
+
+TEST_CASE("Corpus word counts keep counts past the range of an int") {
+    TermCountShard shard;
+    count_chapter_terms_into("war peace war", shard);
+    const uint64_t many = uint64_t(numeric_limits<int>::max()) + 10;
+    shard.counts[shard.dictionary.intern("peace")] = many;
+    CHECK(corpus_word_counts(shard, 0) == vector<CorpusWordCount>{{"peace", many}, {"war", 2}});
+    CHECK(shard.total() == many + 2);
+}
+
+TEST_CASE("Parse CPU List reads sysfs lists") {
+    CHECK(parse_cpu_list("0-3,8,10-11\n") == vector<int>{0, 1, 2, 3, 8, 10, 11});
+    CHECK(parse_cpu_list("5") == vector<int>{5});
+    CHECK(parse_cpu_list("\n").empty());
+    CHECK(parse_cpu_list("3-1").empty());
+    CHECK(parse_cpu_list("a-b").empty());
+    CHECK(parse_cpu_list("1,,2").empty());
+}
+
+TEST_CASE("Split Chapters By Bytes gives every node consecutive chapters of about the same size") {
+    vector<string> chapters = {string(100, 'a'), string(100, 'b'), string(100, 'c'), string(100, 'd'), string(400, 'e')};
+    CHECK(split_chapters_by_bytes(chapters, 2) == vector<pair<size_t, size_t>>{{0, 4}, {4, 5}});
+    CHECK(split_chapters_by_bytes(chapters, 1) == vector<pair<size_t, size_t>>{{0, 5}});
+    CHECK(split_chapters_by_bytes(chapters, 4) == vector<pair<size_t, size_t>>{{0, 2}, {2, 4}, {4, 5}, {5, 5}});
+    CHECK(split_chapters_by_bytes(vector<string>{}, 2) == vector<pair<size_t, size_t>>{{0, 0}, {0, 0}});
+
+    const auto topology = numa_topology();
+    REQUIRE_FALSE(topology.empty());
+    CHECK_FALSE(topology.front().cpus.empty());
+}
+
+TEST_CASE("Chapters split between nodes get the summaries of the serial run") {
+    string book = concatenate_lines(read_lines("./data/book.txt").value());
+    auto chapters = split_book_into_chapter_views(book);
+    const auto filters = book_filters();
+
+    vector<ChapterSummary> expected;
+    for (const string_view chapter : chapters) {
+        expected.push_back(summarize_chapter(chapter)(filters.peace, filters.war));
+    }
+
+    // the CPUs of this machine as three nodes, so the split is used even on a single node
+    const vector<int> cpus = allowed_cpus();
+    REQUIRE_FALSE(cpus.empty());
+    const vector<NumaNode> topology = {{0, cpus}, {1, cpus}, {2, {cpus.front()}}};
+    auto run = summarize_all_chapters_numa(chapters, topology, 2, true)(filters.peace, filters.war);
+    auto same = [](const ChapterSummary& a, const ChapterSummary& b) {
+        return a.warHits == b.warHits && a.peaceHits == b.peaceHits && a.relation == b.relation;
+    };
+    CHECK(equal(run.summaries.begin(), run.summaries.end(), expected.begin(), expected.end(), same));
+    REQUIRE(run.nodes.size() == 3);
+    size_t chapterCount = 0;
+    for (const NodeStats& node : run.nodes) {
+        CHECK(node.workers == 2);
+        CHECK(node.pinned);
+        chapterCount += node.chapters;
+    }
+    CHECK(chapterCount == chapters.size());
+    CHECK(run.nodes[2].node == 2);
+}
+
+Task<int> add_on_loop(EventLoop& loop, const int a, const int b) {
+    co_await loop.schedule();
+    co_return a + b;
+}
+
+Task<int> sum_on_loop(EventLoop& loop, const int count) {
+    vector<Task<int>> tasks;
+    for (int i = 0; i < count; i++) {
+        tasks.push_back(add_on_loop(loop, i, 1));
+    }
+    auto values = co_await when_all(std::move(tasks));
+    co_return accumulate(values.begin(), values.end(), 0);
+}
+
+TEST_CASE("Tasks run on the event loop and sync_wait waits for them") {
+    EventLoop loop;
+    CHECK(sync_wait(loop, add_on_loop(loop, 2, 3)) == 5);
+    CHECK(sync_wait(loop, sum_on_loop(loop, 1000), 4) == 1000 * 999 / 2 + 1000);
+    CHECK(sync_wait(loop, sum_on_loop(loop, 0)) == 0);
+}
+
+TEST_CASE("Async analysis gives the relations of the batch path") {
+    const auto filters = book_filters();
+
+    string book = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(book);
+    const auto bodyText = flatten_lines(book.substr(body.begin, body.end - body.begin));
+    const auto expected = process_all_chapters(split_book_into_chapter_views(bodyText))(filters.peace, filters.war);
+
+    CHECK(process_book("./data/book.txt")(filters.peace, filters.war) == expected);
+    CHECK_FALSE(process_book("./data/missing.txt")(filters.peace, filters.war).has_value());
+    // a directory opens but cannot be read, which ends the chapters with an error instead of a short book
+    CHECK_FALSE(process_book("./data")(filters.peace, filters.war).has_value());
+    {
+        EventLoop loop;
+        auto chapters = analyze_book_async(loop, open_async("./data").value(), filters.peace, filters.war);
+        auto first = [&]() -> Task<bool> {
+            try {
+                co_await chapters.next();
+            } catch (const system_error&) {
+                co_return true;
+            }
+            co_return false;
+        };
+        CHECK(sync_wait(loop, first()));
+    }
+
+    // a pipe that only gets the text bit by bit is waited for with epoll
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    thread writer([&]() {
+        for (size_t i = 0; i < book.size(); i += 200000) {
+            const string_view part = string_view(book).substr(i, 200000);
+            for (size_t written = 0; written < part.size();) {
+                const ssize_t count = write(fds[1], part.data() + written, part.size() - written);
+                written += count > 0 ? size_t(count) : 0;
+            }
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        close(fds[1]);
+    });
+    EventLoop loop;
+    auto fromPipe = [&]() -> Task<map<int, Relation>> {
+        map<int, Relation> relations;
+        auto chapters = analyze_book_async(loop, fds[0], filters.peace, filters.war);
+        while (auto result = co_await chapters.next()) {
+            relations[result->number] = result->summary.relation;
+        }
+        co_return relations;
+    };
+    CHECK(sync_wait(loop, fromPipe()) == expected);
+    writer.join();
+}
+
+TEST_CASE("Thousands of book analyses share a few threads") {
+    const auto filters = term_filters({"peace", "calm"}, {"war", "battle"});
+
+    const string bookPath = "./out/test_async_book.txt";
+    {
+        ofstream out(bookPath, ios::binary);
+        out << "header\n*** START OF THE BOOK ***\nCHAPTER 1\nwar and battle\nCHAPTER 2\ncalm peace war peace\n*** END OF THE BOOK ***\nlicense";
+    }
+    const auto expected = process_book(bookPath)(filters.peace, filters.war);
+    REQUIRE(expected.has_value());
+    CHECK(expected->size() == 2);
+
+    EventLoop loop;
+    vector<Task<optional<map<int, Relation>>>> analyses;
+    for (int i = 0; i < 2000; i++) {
+        analyses.push_back(analyze_book(loop, bookPath, filters.peace, filters.war));
+    }
+    auto results = sync_wait(loop, when_all(std::move(analyses)), 3);
+    CHECK(results.size() == 2000);
+    CHECK(count(results.begin(), results.end(), expected) == 2000);
+    remove(bookPath.c_str());
+}
+
+TEST_CASE("Shared memory rings carry records from a forked process in order") {
+    const size_t capacity = 16;
+    SharedMemory memory(SharedResultRing::bytes_for(capacity));
+    REQUIRE(memory.valid());
+    SharedResultRing ring(memory.get(), capacity);
+
+    const uint32_t recordCount = 1000;
+    const pid_t producer = fork();
+    REQUIRE(producer >= 0);
+    if (producer == 0) {
+        for (uint32_t i = 0; i < recordCount; i++) {
+            ring.push(ChapterRecord{i, ChapterSummary{int(i), int(2 * i), i % 2 == 0 ? Relation::WAR : Relation::PEACE}});
+        }
+        _exit(0);
+    }
+
+    uint32_t received = 0;
+    size_t outOfOrder = 0;
+    ChapterRecord record;
+    while (received < recordCount) {
+        if (!ring.try_pop(record)) {
+            this_thread::yield();
+            continue;
+        }
+        const bool expected = record.chapter == received && record.summary.warHits == int(received) && record.summary.peaceHits == int(2 * received)
+                              && record.summary.relation == (received % 2 == 0 ? Relation::WAR : Relation::PEACE);
+        outOfOrder += expected ? 0 : 1;
+        received++;
+    }
+    CHECK(outOfOrder == 0);
+    CHECK_FALSE(ring.try_pop(record));
+    int status = 0;
+    REQUIRE(waitpid(producer, &status, 0) == producer);
+    CHECK((WIFEXITED(status) && WEXITSTATUS(status) == 0));
+}
+
+TEST_CASE("Worker processes give the summaries of the serial path") {
+    const auto filters = book_filters();
+
+    string book = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(book);
+    const auto bodyText = flatten_lines(book.substr(body.begin, body.end - body.begin));
+    const auto chapters = split_book_into_chapter_views(bodyText);
+    vector<ChapterSummary> expected;
+    for (const string_view chapter : chapters) {
+        expected.push_back(summarize_chapter(chapter)(filters.peace, filters.war));
+    }
+    auto same = [](const ChapterSummary& a, const ChapterSummary& b) {
+        return a.warHits == b.warHits && a.peaceHits == b.peaceHits && a.relation == b.relation;
+    };
+
+    for (size_t workers : {1, 3, 8}) {
+        auto run = summarize_all_chapters_forked(chapters, workers)(filters.peace, filters.war);
+        REQUIRE(run.has_value());
+        CHECK(equal(run->summaries.begin(), run->summaries.end(), expected.begin(), expected.end(), same));
+        CHECK(run->stats.workers == workers);
+        CHECK(run->stats.failed == 0);
+        CHECK(run->stats.recovered == 0);
+    }
+
+    // no more workers than chapters
+    const vector<string_view> two(chapters.begin(), chapters.begin() + 2);
+    auto run = summarize_all_chapters_forked(two, 8)(filters.peace, filters.war);
+    REQUIRE(run.has_value());
+    CHECK(run->stats.workers == 2);
+    CHECK(equal(run->summaries.begin(), run->summaries.end(), expected.begin(), expected.begin() + 2, same));
+}
+
+TEST_CASE("The coordinator makes up for worker processes that fail") {
+    const auto filters = book_filters();
+
+    string book = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(book);
+    const auto bodyText = flatten_lines(book.substr(body.begin, body.end - body.begin));
+    const auto chapters = split_book_into_chapter_views(bodyText);
+    vector<Relation> expected;
+    for (const string_view chapter : chapters) {
+        expected.push_back(summarize_chapter(chapter)(filters.peace, filters.war).relation);
+    }
+
+    // every worker dies in its first chapter, the coordinator filters as usual
+    const pid_t coordinator = getpid();
+    auto crashingWarFilter = [&](const auto& words, auto& filterWords) {
+        if (getpid() != coordinator) {
+            raise(SIGKILL);
+        }
+        filters.war(words, filterWords);
+    };
+    auto run = summarize_all_chapters_forked(chapters, 3)(filters.peace, crashingWarFilter);
+    REQUIRE(run.has_value());
+    CHECK(run->stats.failed == 3);
+    CHECK(run->stats.recovered == chapters.size());
+    vector<Relation> relations;
+    for (const ChapterSummary& summary : run->summaries) {
+        relations.push_back(summary.relation);
+    }
+    CHECK(relations == expected);
+}
+
+TEST_CASE("The coordinator sleeps while its workers are busy") {
+    const vector<string> terms{"war"};
+    auto filterTerms = bind(filter_words_into, placeholders::_1, cref(terms), placeholders::_2);
+    const pid_t coordinator = getpid();
+    auto slowFilter = [&](const auto& words, auto& filterWords) {
+        if (getpid() != coordinator) {
+            this_thread::sleep_for(chrono::milliseconds(200));
+        }
+        filter_words_into(words, terms, filterWords);
+    };
+    const vector<string_view> chapters{"war and peace", "war"};
+
+    const clock_t before = clock();
+    auto run = summarize_all_chapters_forked(chapters, 2)(filterTerms, slowFilter);
+    const double coordinatorMilliseconds = 1000.0 * double(clock() - before) / CLOCKS_PER_SEC;
+    REQUIRE(run.has_value());
+    CHECK(run->stats.failed == 0);
+    CHECK(run->stats.milliseconds >= 200);
+    // spinning through the wait would take about as much processor time as the wait
+    CHECK(coordinatorMilliseconds < 50);
+}
+
+TEST_CASE("Reorder buffer writes results in index order as soon as the gap is filled") {
+    vector<size_t> written;
+    ReorderBuffer<int> reorder(4, [&](const size_t index, int& value) {
+        CHECK(value == int(index) * 10);
+        written.push_back(index);
+    });
+    reorder.complete(3, 30);
+    reorder.complete(1, 10);
+    reorder.complete(2, 20);
+    CHECK(written.empty());
+    CHECK(reorder.written() == 0);
+    reorder.complete(0, 0);
+    CHECK(written == vector<size_t>{0, 1, 2, 3});
+    CHECK(reorder.peak_buffered() == 4);
+
+    // the slots are reused for the next window
+    reorder.complete(4, 40);
+    CHECK(reorder.written() == 5);
+    CHECK(reorder.room_waits() == 0);
+}
+
+TEST_CASE("Reorder buffer holds back a scheduler that is a window ahead") {
+    ReorderBuffer<int> reorder(2, [](size_t, int&) {});
+    atomic<bool> admitted{false};
+    thread scheduler([&]() {
+        reorder.wait_for_room(2);
+        admitted = true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(20));
+    CHECK_FALSE(admitted.load());
+    // finished, but not written while 0 is missing
+    reorder.complete(1, 1);
+    this_thread::sleep_for(chrono::milliseconds(20));
+    CHECK_FALSE(admitted.load());
+    reorder.complete(0, 0);
+    scheduler.join();
+    CHECK(admitted.load());
+    CHECK(reorder.written() == 2);
+    CHECK(reorder.room_waits() == 1);
+}
+
+TEST_CASE("Streamed parallel chapters come in order within the window") {
+    const auto filters = book_filters();
+
+    string book = read_text("./data/book.txt").value();
+    const auto body = find_gutenberg_body(book);
+    const auto bodyText = flatten_lines(book.substr(body.begin, body.end - body.begin));
+    const auto chapters = split_book_into_chapter_views(bodyText);
+    const auto expected = process_all_chapters(chapters)(filters.peace, filters.war);
+
+    ThreadPool pool(4);
+    for (size_t window : {1, 3, 64}) {
+        map<int, Relation> emitted;
+        size_t outOfOrder = 0;
+        auto collect = [&](const int number, const ChapterSummary& summary) {
+            outOfOrder += number == int(emitted.size()) + 1 ? 0 : 1;
+            emitted[number] = summary.relation;
+        };
+        const auto stats = stream_all_chapters_parallel(chapters, pool, window, collect)(filters.peace, filters.war);
+        CHECK(outOfOrder == 0);
+        CHECK(emitted == expected);
+        CHECK(stats.chapters == chapters.size());
+        CHECK(stats.peakBuffered <= window);
+    }
+}
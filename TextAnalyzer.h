@@ -0,0 +1,1077 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <functional>
+#include <numeric>
+#include <map>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <type_traits>
+#include <cstring>
+#include <string_view>
+#include <sstream>
+
+#include "PositionList.h"
+
+using namespace std;
+using namespace std::placeholders;
+
+struct Word {
+    string str;
+    int indexInText;
+
+    bool operator==(const Word& other) const {
+        return str == other.str && indexInText == other.indexInText;
+    }
+};
+
+struct WordCount{
+    string word;
+    int count;
+
+    bool operator==(const WordCount& other) const {
+        return word == other.word && count == other.count;
+    }
+};
+
+enum struct Relation {
+    WAR = 0,
+    PEACE = 1
+};
+
+const string relationToString(const Relation rel) {
+    switch (rel) {
+        case Relation::WAR:
+            return "war";
+        case Relation::PEACE:
+            return "peace";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+void print_evaluation(const int chapter, const Relation relation) {
+    cout << "Chapter " << chapter << ": " << relationToString(relation) << "-related" << endl;
+}
+
+void print_evaluations(const map<int, Relation>& evaluations) {
+    for_each(evaluations.begin(), evaluations.end(), [](const auto& pair) {
+        print_evaluation(pair.first, pair.second);
+    });
+}
+
+#pragma region IO Reading
+//Step 2: Read files
+auto read_lines = [](const string& filePath) -> optional<vector<string>> {
+    ifstream inputFile(filePath);
+
+    if(inputFile.is_open()){
+        vector<string> values;
+
+        string line;
+        while(getline(inputFile, line)){
+            values.push_back(line);
+        }
+
+        return values;
+    }
+    else{
+        return nullopt;
+    }
+};
+
+// The term lists are saved with CRLF line endings, so strip the '\r' and skip blank lines
+auto read_terms = [](const string& filePath) -> optional<vector<string>> {
+    auto lines = read_lines(filePath);
+    if(!lines.has_value()){
+        return nullopt;
+    }
+
+    vector<string> terms;
+    for_each(lines->begin(), lines->end(), [&terms](string line) {
+        line.erase(find_if(line.rbegin(), line.rend(), [](unsigned char c) {
+            return !isspace(c);
+        }).base(), line.end());
+        if(!line.empty()){
+            terms.push_back(line);
+        }
+    });
+    return terms;
+};
+
+// Joins the lines with a single space, appending in place instead of copying the accumulator per line
+auto concatenate_lines = [](const vector<string>& lines) -> string {
+    size_t totalSize = accumulate(lines.begin(), lines.end(), size_t{0}, [](size_t sum, const string& line){
+        return sum + line.size() + 1;
+    });
+
+    string result;
+    result.reserve(totalSize);
+    for_each(lines.begin(), lines.end(), [&result](const string& line){
+        result += line;
+        result += ' ';
+    });
+    return result;
+};
+
+// Reads the whole file as it is, line breaks included
+auto read_text = [](const string& filePath) -> optional<string> {
+    ifstream inputFile(filePath, ios::binary);
+    if(!inputFile.is_open()){
+        return nullopt;
+    }
+    return string(istreambuf_iterator<char>(inputFile), istreambuf_iterator<char>());
+};
+
+// Same text as concatenate_lines(read_lines(...)) for a file ending in a line break, with every
+// offset unchanged, so an index built on the raw text stays valid
+auto flatten_lines = [](string text) -> string {
+    replace(text.begin(), text.end(), '\n', ' ');
+    return text;
+};
+#pragma endregion IO Reading
+
+#pragma region tokenize
+//Step 3: Tokenize the text
+auto remove_special_characters = [](string str) {
+    str.erase(remove_if(str.begin(), str.end(), [](char c) {
+        return !isalnum(c) && c != ' ';
+    }), str.end());
+    return str;
+};
+
+// Splits like getline on the separator: consecutive separators give empty tokens, a trailing one does not.
+// The words are appended to splittedWords, any vector of Word.
+auto tokenize_into = [](const string_view line, const char separator, auto& splittedWords) {
+    int index = 0;
+    size_t start = 0;
+    while (start < line.size()) {
+        size_t end = line.find(separator, start);
+        if (end == string_view::npos) {
+            end = line.size();
+        }
+        const string_view token = line.substr(start, end - start);
+        start = end + 1;
+
+        string subString = remove_special_characters(string(token));
+
+        transform(subString.begin(), subString.end(), subString.begin(), [](unsigned char c) {
+            return tolower(c);
+        });
+
+        if (!subString.empty()) {
+            splittedWords.push_back(Word{std::move(subString), index});
+            index += token.size() + 1; // Increment index by the size of the token plus 1 for the separator
+        } else {
+            splittedWords.push_back(Word{});
+        }
+    }
+};
+
+auto tokenize = [](const string_view line, const char separator) -> vector<Word> {
+    vector<Word> splittedWords;
+    tokenize_into(line, separator, splittedWords);
+    return splittedWords;
+};
+
+struct ChapterRange {
+    size_t begin;
+    size_t end;
+
+    bool operator==(const ChapterRange& other) const {
+        return begin == other.begin && end == other.end;
+    }
+};
+
+// Finds the text between "CHAPTER <digits>" headings as offsets into the book. memchr jumps to the
+// next 'C' and only there the heading is verified. Text before the first heading is skipped, an empty
+// chapter after the last heading is dropped, as with the regex split this replaces.
+auto find_chapter_ranges = [](const string_view book) -> vector<ChapterRange> {
+    static constexpr string_view heading = "CHAPTER ";
+    vector<ChapterRange> ranges;
+    optional<size_t> chapterBegin;
+
+    size_t position = 0;
+    while (position < book.size()) {
+        const void* candidate = memchr(book.data() + position, 'C', book.size() - position);
+        if (candidate == nullptr) {
+            break;
+        }
+        size_t at = static_cast<const char*>(candidate) - book.data();
+        size_t digits = at + heading.size();
+        if (digits >= book.size() || book.compare(at, heading.size(), heading) != 0 || !isdigit(static_cast<unsigned char>(book[digits]))) {
+            position = at + 1;
+            continue;
+        }
+
+        while (digits < book.size() && isdigit(static_cast<unsigned char>(book[digits]))) {
+            digits++;
+        }
+        if (chapterBegin.has_value()) {
+            ranges.push_back(ChapterRange{chapterBegin.value(), at});
+        }
+        chapterBegin = digits;
+        position = digits;
+    }
+
+    if (chapterBegin.has_value() && chapterBegin.value() < book.size()) {
+        ranges.push_back(ChapterRange{chapterBegin.value(), book.size()});
+    }
+    return ranges;
+};
+
+// The text between the Project Gutenberg markers: from the closing "***" of the "*** START OF"
+// line up to the "*** END OF" line. The END marker is searched backward from the end of the file,
+// so the license after it is never scanned; without markers the whole text is the body.
+auto find_gutenberg_body = [](const string_view text) -> ChapterRange {
+    ChapterRange body{0, text.size()};
+
+    size_t start = text.find("*** START OF");
+    if(start != string_view::npos){
+        size_t closing = text.find("***", start + 3);
+        size_t lineEnd = text.find('\n', start);
+        body.begin = closing != string_view::npos && closing < lineEnd ? closing + 3
+                   : lineEnd == string_view::npos ? text.size() : lineEnd + 1;
+    }
+
+    size_t end = text.rfind("*** END OF");
+    if(end != string_view::npos && end >= body.begin){
+        body.end = end;
+    }
+    return body;
+};
+
+// The chapters as views into the book, which has to outlive them. Every view is written to its own
+// slot, so the transform stays correct under a parallel execution policy.
+auto split_book_into_chapter_views = [](const string_view book) -> vector<string_view> {
+    auto ranges = find_chapter_ranges(book);
+    vector<string_view> chapters(ranges.size());
+    transform(ranges.begin(), ranges.end(), chapters.begin(), [book](const ChapterRange& range) {
+        return book.substr(range.begin, range.end - range.begin);
+    });
+    return chapters;
+};
+
+auto split_book_into_chapters = [](const string& book) -> vector<string> {
+    auto views = split_book_into_chapter_views(book);
+    return vector<string>(views.begin(), views.end());
+};
+
+//Step 4: Filter the words
+// The _into variants of the filters append to a vector the caller provides, e.g. one in a chapter arena
+auto filter_words_into = [](const auto& words, const vector<string>& filter, auto& filterWords) {
+    copy_if(words.begin(), words.end(), back_inserter(filterWords), [&filter](const Word& word){
+        return std::find_if(filter.begin(), filter.end(), [&](const std::string& filterWord) {
+            return filterWord == word.str;
+        }) != filter.end();
+    });
+};
+
+auto filter_words = [](const vector<Word>& words, const vector<string>& filter) -> vector<Word> {
+    vector<Word> filterWords;
+    filter_words_into(words, filter, filterWords);
+    return filterWords;
+};
+
+// Step 5: Count occurrences
+auto calculate_wordCount_into = [](const auto& wordMap, auto& result) {
+    for_each(wordMap.begin(), wordMap.end(), [&](const auto& pair){
+        int wordCount = pair.second.size();
+        result.push_back(WordCount{pair.first, wordCount});
+    });
+};
+
+auto calculate_wordCount = [](const map<string, vector<Word>>& wordMap) -> vector<WordCount> {
+    vector<WordCount> result;
+    calculate_wordCount_into(wordMap, result);
+    return result;
+};
+#pragma endregion tokenize
+
+#pragma region map words
+auto map_words_into = [](const auto& words, auto& wordMap) {
+    for_each(words.begin(), words.end(), [&wordMap](const Word& word) {
+        wordMap[word.str].push_back(word);
+    });
+};
+
+auto map_words = [](const vector<Word>& words) -> map<string, vector<Word>> {
+    map<string, vector<Word>> wordMap;
+    map_words_into(words, wordMap);
+    return wordMap;
+};
+
+// Step 6: Calculate term density
+auto calculate_density = [](const auto& words) -> double {
+    if(words.size() < 2){
+        return -1.0;
+    }
+
+    double distanceSum = accumulate(words.begin(), words.end() - 1, 0.0, [](double sum, const Word& word){
+        auto next = &word + 1;
+        int distance = next->indexInText - word.indexInText;
+        return sum + distance;
+    });
+
+    return distanceSum / (words.size() - 1);
+};
+
+auto get_relation_value = [](const auto& wordData, const double& density){
+    int sumCount = accumulate(wordData.begin(), wordData.end(), 0, [](const int accumulator, const WordCount& item){
+        return accumulator + item.count;
+    });
+
+    return sumCount + (200 - density);
+};
+#pragma endregion map words
+
+#pragma region chapter arena
+// Working memory of one chapter: a monotonic arena that is released as a whole between chapters.
+// Whatever a chapter needed beyond the buffer is added to it on the next reset, so after the
+// largest chapter so far the arena no longer goes to the heap.
+struct ChapterArena {
+    // Upstream of the arena that remembers how much it had to hand out
+    struct OverflowResource : pmr::memory_resource {
+        size_t bytes = 0;
+
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return pmr::new_delete_resource()->allocate(size, alignment);
+        }
+        void do_deallocate(void* pointer, size_t size, size_t alignment) override {
+            pmr::new_delete_resource()->deallocate(pointer, size, alignment);
+        }
+        bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    explicit ChapterArena(size_t initialSize = size_t(1) << 20) : buffer(initialSize) {
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+    ChapterArena(const ChapterArena&) = delete;
+    ChapterArena& operator=(const ChapterArena&) = delete;
+
+    pmr::memory_resource* resource() {
+        return &arena.value();
+    }
+
+    // Everything allocated from the arena must be gone by now
+    void reset() {
+        arena->release();
+        if(overflow.bytes > 0){
+            buffer = vector<byte>(buffer.size() + overflow.bytes);
+            overflow.bytes = 0;
+            arena.emplace(buffer.data(), buffer.size(), &overflow);
+        }
+    }
+
+    vector<byte> buffer;
+    OverflowResource overflow;
+    optional<pmr::monotonic_buffer_resource> arena;
+};
+
+// One arena per thread, so every worker reuses its own
+auto chapter_arena = []() -> ChapterArena& {
+    thread_local ChapterArena arena;
+    return arena;
+};
+
+// Calls a filter that appends into a vector if it can, otherwise copies what it returns. std::bind
+// drops surplus arguments, so only a filter returning void counts as one that appends.
+auto apply_filter = [](const auto& filter, const auto& words, auto& filterWords) {
+    using Filter = decltype(filter);
+    using Words = decltype(words);
+    using FilterWords = decltype(filterWords);
+    constexpr bool appends = []() {
+        if constexpr (is_invocable_v<Filter, Words, FilterWords>) {
+            return is_void_v<invoke_result_t<Filter, Words, FilterWords>>;
+        } else {
+            return false;
+        }
+    }();
+
+    if constexpr (appends) {
+        filter(words, filterWords);
+    } else {
+        auto result = filter(vector<Word>(words.begin(), words.end()));
+        copy(result.begin(), result.end(), back_inserter(filterWords));
+    }
+};
+#pragma endregion chapter arena
+
+#pragma region token block
+// Tokens of a chapter as two parallel columns instead of a vector of Word: the term id of every
+// token and its position in the text. Both columns start on a cache line, so the stages after
+// tokenizing run over contiguous uint32 arrays.
+constexpr size_t cacheLineSize = 64;
+
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+
+    pmr::memory_resource* resource;
+
+    CacheAlignedAllocator(pmr::memory_resource* resource = pmr::get_default_resource()) noexcept : resource(resource) {}
+
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>& other) noexcept : resource(other.resource) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(resource->allocate(count * sizeof(T), cacheLineSize));
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        resource->deallocate(pointer, count * sizeof(T), cacheLineSize);
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>& other) const noexcept {
+        return resource == other.resource;
+    }
+
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>& other) const noexcept {
+        return resource != other.resource;
+    }
+};
+
+using TokenColumn = vector<uint32_t, CacheAlignedAllocator<uint32_t>>;
+
+struct TokenBlock {
+    TokenColumn termIds;
+    TokenColumn positions;
+
+    explicit TokenBlock(pmr::memory_resource* memory = pmr::get_default_resource())
+        : termIds(CacheAlignedAllocator<uint32_t>(memory)), positions(CacheAlignedAllocator<uint32_t>(memory)) {}
+
+    size_t size() const {
+        return termIds.size();
+    }
+
+    void push_back(const uint32_t termId, const uint32_t position) {
+        termIds.push_back(termId);
+        positions.push_back(position);
+    }
+};
+
+// The distinct tokens of a chapter; the spelling of id ends at ends[id] in spellings. Ids are found
+// through an open addressing table of id + 1 (0 marks a free slot) that is kept at most half full.
+struct TermDictionary {
+    pmr::vector<uint32_t> slots;
+    pmr::vector<char> spellings;
+    pmr::vector<uint32_t> ends;
+
+    explicit TermDictionary(pmr::memory_resource* memory = pmr::get_default_resource())
+        : slots(64, 0, memory), spellings(memory), ends(memory) {}
+
+    size_t size() const {
+        return ends.size();
+    }
+
+    string_view term(const uint32_t id) const {
+        uint32_t begin = id == 0 ? 0 : ends[id - 1];
+        return string_view(spellings.data() + begin, ends[id] - begin);
+    }
+
+    uint32_t intern(const string_view spelling) {
+        size_t mask = slots.size() - 1;
+        size_t slot = hash<string_view>{}(spelling) & mask;
+        while (slots[slot] != 0) {
+            uint32_t id = slots[slot] - 1;
+            if (term(id) == spelling) {
+                return id;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        uint32_t id = uint32_t(size());
+        spellings.insert(spellings.end(), spelling.begin(), spelling.end());
+        ends.push_back(uint32_t(spellings.size()));
+        slots[slot] = id + 1;
+        if (size() * 2 > slots.size()) {
+            rehash(slots.size() * 2);
+        }
+        return id;
+    }
+
+    void rehash(const size_t capacity) {
+        slots.assign(capacity, 0);
+        for (uint32_t id = 0; id < size(); id++) {
+            size_t slot = hash<string_view>{}(term(id)) & (capacity - 1);
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = id + 1;
+        }
+    }
+};
+
+// Calls action with the term id and position of every token of tokenize_into, empty tokens are left
+// out since no filter keeps them. Returns the position a token following the line would get.
+auto for_each_block_token = [](const string_view line, const char separator, TermDictionary& dictionary, const auto& action) -> uint32_t {
+    pmr::string term(dictionary.spellings.get_allocator().resource());
+    uint32_t index = 0;
+    size_t start = 0;
+    while (start < line.size()) {
+        size_t end = line.find(separator, start);
+        if (end == string_view::npos) {
+            end = line.size();
+        }
+        const string_view token = line.substr(start, end - start);
+        start = end + 1;
+
+        term.resize(max(term.size(), token.size()));
+        size_t length = 0;
+        for (char c : token) {
+            if (isalnum(c) || c == ' ') {
+                term[length++] = char(tolower(static_cast<unsigned char>(c)));
+            }
+        }
+
+        if (length > 0) {
+            action(dictionary.intern(string_view(term.data(), length)), index);
+            index += token.size() + 1;
+        }
+    }
+    return index;
+};
+
+auto tokenize_block = [](const string_view line, const char separator, TermDictionary& dictionary, TokenBlock& block) -> uint32_t {
+    // Roughly one token per six bytes of English text
+    block.termIds.reserve(block.size() + line.size() / 6);
+    block.positions.reserve(block.size() + line.size() / 6);
+    return for_each_block_token(line, separator, dictionary, [&block](const uint32_t termId, const uint32_t position) {
+        block.push_back(termId, position);
+    });
+};
+
+// The words a filter is called with, without copying them into a vector
+struct WordSpan {
+    const Word* first;
+    const Word* last;
+
+    const Word* begin() const {
+        return first;
+    }
+    const Word* end() const {
+        return last;
+    }
+    size_t size() const {
+        return last - first;
+    }
+};
+
+// Takes the place of the vector a filter appends to and only marks the term ids it is given
+struct TermMatches {
+    using value_type = Word;
+
+    pmr::vector<uint8_t>* matches;
+
+    void push_back(const Word& word) {
+        (*matches)[word.indexInText] = 1;
+    }
+};
+
+// The Word a filter sees for each term. It belongs to the thread and keeps its buffer, so terms
+// longer than the small string buffer do not allocate once the thread has seen one.
+auto classification_word = []() -> Word& {
+    thread_local Word word = []() {
+        Word reserved{};
+        reserved.str.reserve(256);
+        return reserved;
+    }();
+    return word;
+};
+
+// Runs a word filter on the term with the next id, matches.size(), and appends whether it kept it.
+// The filter has to keep the indexInText of the words it lets through, which here is the term id.
+auto classify_term = [](const auto& filter, const TermDictionary& dictionary, pmr::vector<uint8_t>& matches) {
+    const uint32_t id = uint32_t(matches.size());
+    matches.push_back(0);
+    TermMatches marked{&matches};
+    Word& word = classification_word();
+    word.str.assign(dictionary.term(id));
+    word.indexInText = int(id);
+    apply_filter(filter, WordSpan{&word, &word + 1}, marked);
+};
+
+// Runs a word filter once per distinct term instead of once per token
+auto classify_terms = [](const auto& filter, const TermDictionary& dictionary, pmr::vector<uint8_t>& matches) {
+    matches.clear();
+    matches.reserve(dictionary.size());
+    while (matches.size() < dictionary.size()) {
+        classify_term(filter, dictionary, matches);
+    }
+};
+
+auto filter_block_into = [](const TokenBlock& block, const pmr::vector<uint8_t>& matches, TokenBlock& filtered) {
+    for (size_t i = 0; i < block.size(); i++) {
+        if (matches[block.termIds[i]]) {
+            filtered.push_back(block.termIds[i], block.positions[i]);
+        }
+    }
+};
+
+// Same value as calculate_density over the words of the block
+auto calculate_block_density = [](const TokenBlock& block) -> double {
+    if(block.size() < 2){
+        return -1.0;
+    }
+
+    const uint32_t* positions = block.positions.data();
+    int64_t distanceSum = 0;
+    for (size_t i = 0; i + 1 < block.size(); i++) {
+        distanceSum += int64_t(positions[i + 1]) - int64_t(positions[i]);
+    }
+
+    return double(distanceSum) / (block.size() - 1);
+};
+
+#pragma endregion token block
+
+#pragma region term table
+// Hits per term of a filtered block in a flat Robin Hood table keyed by term id. Each entry keeps
+// its count and the first and last token of its position list inline, the lists are chained
+// through next, which has one slot per token of the block.
+constexpr uint32_t noTerm = numeric_limits<uint32_t>::max();
+
+struct TermEntry {
+    uint32_t termId = noTerm;
+    uint32_t count = 0;
+    uint32_t head = noTerm;
+    uint32_t tail = noTerm;
+};
+
+struct TermTable {
+    pmr::vector<TermEntry> entries;
+    pmr::vector<uint8_t> distances; // probe distance + 1 of every slot, 0 for a free one
+    pmr::vector<uint32_t> next;
+    size_t size = 0;
+
+    explicit TermTable(pmr::memory_resource* memory = pmr::get_default_resource())
+        : entries(16, TermEntry{}, memory), distances(16, 0, memory), next(memory) {}
+
+    size_t home(const uint32_t termId) const {
+        return (uint64_t(termId) * 0x9E3779B97F4A7C15ull >> 32) & (entries.size() - 1);
+    }
+
+    optional<size_t> find(const uint32_t termId) const {
+        size_t slot = home(termId);
+        for (uint8_t distance = 1; distances[slot] >= distance; distance++) {
+            if (entries[slot].termId == termId) {
+                return slot;
+            }
+            slot = (slot + 1) & (entries.size() - 1);
+        }
+        return nullopt;
+    }
+
+    // Returns the slot the entry ends up in; entries that are closer to home move on
+    size_t insert(TermEntry entry) {
+        optional<size_t> placed;
+        size_t slot = home(entry.termId);
+        uint8_t distance = 1;
+        while (distances[slot] != 0) {
+            if (distances[slot] < distance) {
+                swap(entry, entries[slot]);
+                swap(distance, distances[slot]);
+                if (!placed) {
+                    placed = slot;
+                }
+            }
+            slot = (slot + 1) & (entries.size() - 1);
+            distance++;
+        }
+        entries[slot] = entry;
+        distances[slot] = distance;
+        size++;
+        return placed.value_or(slot);
+    }
+
+    void grow() {
+        pmr::vector<TermEntry> old(entries.size() * 2, TermEntry{}, entries.get_allocator());
+        old.swap(entries);
+        distances.assign(entries.size(), 0);
+        size = 0;
+        for (const TermEntry& entry : old) {
+            if (entry.termId != noTerm) {
+                insert(entry);
+            }
+        }
+    }
+
+    void add(const uint32_t termId, const uint32_t token) {
+        optional<size_t> slot = find(termId);
+        if (!slot) {
+            if ((size + 1) * 4 > entries.size() * 3) {
+                grow();
+            }
+            slot = insert(TermEntry{termId});
+        }
+
+        TermEntry& entry = entries[slot.value()];
+        if (entry.count == 0) {
+            entry.head = token;
+        } else {
+            next[entry.tail] = token;
+        }
+        entry.tail = token;
+        entry.count++;
+    }
+};
+
+auto count_block_terms_into = [](const TokenBlock& block, TermTable& table) {
+    table.next.assign(block.size(), noTerm);
+    for (uint32_t token = 0; token < block.size(); token++) {
+        table.add(block.termIds[token], token);
+    }
+};
+
+auto get_block_relation_value = [](const TermTable& table, const double& density){
+    int sumCount = accumulate(table.entries.begin(), table.entries.end(), 0, [](const int accumulator, const TermEntry& entry){
+        return accumulator + int(entry.count);
+    });
+
+    return sumCount + (200 - density);
+};
+
+// The table is unordered, only output for reading is sorted by word
+auto sorted_entries = [](const TermTable& table, const TermDictionary& dictionary) -> vector<TermEntry> {
+    vector<TermEntry> result;
+    result.reserve(table.size);
+    copy_if(table.entries.begin(), table.entries.end(), back_inserter(result), [](const TermEntry& entry) {
+        return entry.termId != noTerm;
+    });
+    sort(result.begin(), result.end(), [&dictionary](const TermEntry& a, const TermEntry& b) {
+        return dictionary.term(a.termId) < dictionary.term(b.termId);
+    });
+    return result;
+};
+
+auto word_counts_of = [](const vector<TermEntry>& entries, const TermDictionary& dictionary) -> vector<WordCount> {
+    vector<WordCount> result;
+    result.reserve(entries.size());
+    transform(entries.begin(), entries.end(), back_inserter(result), [&dictionary](const TermEntry& entry) {
+        return WordCount{string(dictionary.term(entry.termId)), int(entry.count)};
+    });
+    return result;
+};
+
+auto sorted_word_counts = [](const TermTable& table, const TermDictionary& dictionary) -> vector<WordCount> {
+    return word_counts_of(sorted_entries(table, dictionary), dictionary);
+};
+
+// The positions of the given entries of a table counted over block, read off their chains: list i of
+// the index holds those of entries[i]
+auto encode_term_positions = [](const TermTable& table, const vector<TermEntry>& entries, const TokenBlock& block) -> PositionIndex {
+    PositionIndex index;
+    index.entries.reserve(entries.size());
+    for (const TermEntry& entry : entries) {
+        index.add_list([&](const auto& add) {
+            for (uint32_t token = entry.head; token != noTerm; token = table.next[token]) {
+                add(block.positions[token]);
+            }
+        });
+    }
+    index.shrink_to_fit();
+    return index;
+};
+#pragma endregion term table
+
+#pragma region category hits
+// All the score of a category needs: count, first and last position and the sum of the gaps between
+// consecutive hits. With the span of the text they come from they form a monoid, see merge_hits.
+struct CategoryHits {
+    uint32_t count = 0;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint32_t gapSum = 0;
+
+    void add(const uint32_t position) {
+        if (count == 0) {
+            first = position;
+        } else {
+            gapSum += position - last;
+        }
+        last = position;
+        count++;
+    }
+
+    bool operator==(const CategoryHits& other) const {
+        return count == other.count && first == other.first && last == other.last && gapSum == other.gapSum;
+    }
+};
+
+auto calculate_hits_density = [](const CategoryHits& hits) -> double {
+    if(hits.count < 2){
+        return -1.0;
+    }
+    return double(hits.gapSum) / (hits.count - 1);
+};
+
+auto get_hits_relation_value = [](const CategoryHits& hits, const double& density){
+    return int(hits.count) + (200 - density);
+};
+
+// b follows a piece of text that moves its positions by span; the gap across the boundary is
+// the one between the last hit of a and the first of b
+auto merge_hits = [](const CategoryHits& a, const uint32_t span, const CategoryHits& b) -> CategoryHits {
+    if (b.count == 0) {
+        return a;
+    }
+    if (a.count == 0) {
+        return CategoryHits{b.count, span + b.first, span + b.last, b.gapSum};
+    }
+    return CategoryHits{a.count + b.count, a.first, span + b.last, a.gapSum + (span + b.first - a.last) + b.gapSum};
+};
+#pragma endregion category hits
+
+struct ChapterSummary {
+    int warHits;
+    int peaceHits;
+    Relation relation;
+};
+
+// The hits of a piece of a chapter, positions relative to the start of the piece. span is what the
+// piece adds to the positions after it. Pieces split at a separator merge into the hits of the whole.
+// ChapterPartial{} is the identity of merge_partials, which is associative, so pieces can be merged in
+// any grouping as long as their order is kept.
+struct ChapterPartial {
+    CategoryHits war;
+    CategoryHits peace;
+    uint32_t span = 0;
+
+    bool operator==(const ChapterPartial& other) const {
+        return war == other.war && peace == other.peace && span == other.span;
+    }
+};
+
+auto merge_partials = [](const ChapterPartial& left, const ChapterPartial& right) -> ChapterPartial {
+    return ChapterPartial{merge_hits(left.war, left.span, right.war), merge_hits(left.peace, left.span, right.peace),
+                          left.span + right.span};
+};
+
+// Merges partials given in text order as a balanced tree without allocating: like a binary counter,
+// two partials of the same level, each standing for 2^level pieces, are merged into one of the next.
+struct PartialReduction {
+    array<ChapterPartial, 64> partials;
+    array<uint8_t, 64> levels;
+    size_t size = 0;
+
+    void add(const ChapterPartial& partial) {
+        partials[size] = partial;
+        levels[size] = 0;
+        size++;
+        while (size >= 2 && levels[size - 2] == levels[size - 1]) {
+            partials[size - 2] = merge_partials(partials[size - 2], partials[size - 1]);
+            levels[size - 2]++;
+            size--;
+        }
+    }
+
+    ChapterPartial result() const {
+        ChapterPartial reduced;
+        for (size_t i = size; i > 0; i--) {
+            reduced = merge_partials(partials[i - 1], reduced);
+        }
+        return reduced;
+    }
+};
+
+// Calls action with consecutive pieces of the text of at most pieceSize bytes where possible. Pieces
+// end before a separator, which belongs to neither piece, so their partials merge into the whole.
+auto for_each_piece = [](const string_view text, const size_t pieceSize, const char separator, const auto& action) {
+    size_t start = 0;
+    while (text.size() - start > pieceSize) {
+        size_t end = text.rfind(separator, start + pieceSize);
+        if (end == string_view::npos || end < start) {
+            end = text.find(separator, start + pieceSize);
+        }
+        if (end == string_view::npos) {
+            break;
+        }
+        action(text.substr(start, end - start));
+        start = end + 1;
+    }
+    action(text.substr(start));
+};
+
+// Count-only scoring: a term is classified when the tokenizer first meets it and every hit goes
+// straight into the CategoryHits, so no token or position is stored. Every container of the piece
+// is allocated from memory.
+auto partial_summary_with = [](const string_view piece, pmr::memory_resource* memory) {
+    return [piece, memory](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterPartial {
+        TermDictionary dictionary(memory);
+        pmr::vector<uint8_t> warMatches(memory);
+        pmr::vector<uint8_t> peaceMatches(memory);
+        ChapterPartial partial;
+        partial.span = for_each_block_token(piece, ' ', dictionary, [&](const uint32_t termId, const uint32_t position) {
+            if (termId == warMatches.size()) {
+                classify_term(filterWarTerms, dictionary, warMatches);
+                classify_term(filterPeaceTerms, dictionary, peaceMatches);
+            }
+            if (warMatches[termId]) {
+                partial.war.add(position);
+            }
+            if (peaceMatches[termId]) {
+                partial.peace.add(position);
+            }
+        });
+        return partial;
+    };
+};
+
+auto summarize_partial = [](const ChapterPartial& partial) -> ChapterSummary {
+    int warRelationValue = get_hits_relation_value(partial.war, calculate_hits_density(partial.war));
+    int peaceRelationValue = get_hits_relation_value(partial.peace, calculate_hits_density(partial.peace));
+
+    return ChapterSummary{int(partial.war.count), int(partial.peace.count),
+                          (warRelationValue > peaceRelationValue) ? Relation::WAR : Relation::PEACE};
+};
+
+auto summarize_chapter_with = [](const string_view chapter, pmr::memory_resource* memory) {
+    return [chapter, memory](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterSummary {
+        return summarize_partial(partial_summary_with(chapter, memory)(filterPeaceTerms, filterWarTerms));
+    };
+};
+
+// The positions of the term of warCounts[i] are list i of warPositions, the same for peace
+struct ChapterDetail {
+    ChapterSummary summary;
+    vector<WordCount> warCounts;
+    vector<WordCount> peaceCounts;
+    PositionIndex warPositions;
+    PositionIndex peacePositions;
+};
+
+// Verbose scoring: keeps the hits of every term with their positions, compressed, for the detailed output
+auto detail_chapter_with = [](const string_view chapter, pmr::memory_resource* memory) {
+    return [chapter, memory](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterDetail {
+        TermDictionary dictionary(memory);
+        TokenBlock chapterBlock(memory);
+        tokenize_block(chapter, ' ', dictionary, chapterBlock);
+
+        pmr::vector<uint8_t> warMatches(memory);
+        pmr::vector<uint8_t> peaceMatches(memory);
+        classify_terms(filterWarTerms, dictionary, warMatches);
+        classify_terms(filterPeaceTerms, dictionary, peaceMatches);
+
+        TokenBlock warWords(memory);
+        TokenBlock peaceWords(memory);
+        filter_block_into(chapterBlock, warMatches, warWords);
+        filter_block_into(chapterBlock, peaceMatches, peaceWords);
+
+        TermTable warResult(memory);
+        TermTable peaceResult(memory);
+        count_block_terms_into(warWords, warResult);
+        count_block_terms_into(peaceWords, peaceResult);
+
+        auto warDensity = calculate_block_density(warWords);
+        auto peaceDensity = calculate_block_density(peaceWords);
+
+        int warRelationValue = get_block_relation_value(warResult, warDensity);
+        int peaceRelationValue = get_block_relation_value(peaceResult, peaceDensity);
+
+        ChapterSummary summary{int(warWords.size()), int(peaceWords.size()),
+                               (warRelationValue > peaceRelationValue) ? Relation::WAR : Relation::PEACE};
+        const auto warEntries = sorted_entries(warResult, dictionary);
+        const auto peaceEntries = sorted_entries(peaceResult, dictionary);
+        return ChapterDetail{summary, word_counts_of(warEntries, dictionary), word_counts_of(peaceEntries, dictionary),
+                             encode_term_positions(warResult, warEntries, warWords),
+                             encode_term_positions(peaceResult, peaceEntries, peaceWords)};
+    };
+};
+
+// Pieces are scored one after the other and the arena is reset after each, so its size is bounded by
+// the piece size and not by the longest chapter
+constexpr size_t chapterPieceSize = size_t(64) << 10;
+
+// Uses the arena of the calling thread and resets it once the chapter is done
+auto summarize_chapter = [](const string_view chapter) {
+    return [chapter](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterSummary {
+        ChapterArena& arena = chapter_arena();
+        PartialReduction reduction;
+        for_each_piece(chapter, chapterPieceSize, ' ', [&](const string_view piece) {
+            reduction.add(partial_summary_with(piece, arena.resource())(filterPeaceTerms, filterWarTerms));
+            arena.reset();
+        });
+        return summarize_partial(reduction.result());
+    };
+};
+
+auto partial_summary = [](const string_view piece) {
+    return [piece](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterPartial {
+        ChapterArena& arena = chapter_arena();
+        auto partial = partial_summary_with(piece, arena.resource())(filterPeaceTerms, filterWarTerms);
+        arena.reset();
+        return partial;
+    };
+};
+
+auto detail_chapter = [](const string_view chapter) {
+    return [chapter](const auto& filterPeaceTerms, const auto& filterWarTerms) -> ChapterDetail {
+        ChapterArena& arena = chapter_arena();
+        auto detail = detail_chapter_with(chapter, arena.resource())(filterPeaceTerms, filterWarTerms);
+        arena.reset();
+        return detail;
+    };
+};
+
+// Every term with its count and the offsets of its first and last occurrence in the chapter
+void print_word_counts(const string& category, const vector<WordCount>& counts, const PositionIndex& positions) {
+    int total = accumulate(counts.begin(), counts.end(), 0, [](const int sum, const WordCount& item) {
+        return sum + item.count;
+    });
+    cout << "  " << category << " terms: " << total;
+    for (size_t i = 0; i < counts.size(); i++) {
+        const PositionListView list = positions.list(uint32_t(i));
+        cout << (i == 0 ? " (" : ", ") << counts[i].word << " " << counts[i].count << " at " << skip_to(list, 0).value();
+        if (list.count > 1) {
+            cout << ".." << list.last;
+        }
+    }
+    cout << (counts.empty() ? "" : ")") << endl;
+}
+
+void print_chapter_detail(const int chapterNumber, const ChapterDetail& detail) {
+    cout << "Chapter " << chapterNumber << ": " << relationToString(detail.summary.relation) << "-related" << endl;
+    print_word_counts("war", detail.warCounts, detail.warPositions);
+    print_word_counts("peace", detail.peaceCounts, detail.peacePositions);
+}
+
+auto process_chapter = [](const string_view chapter) {
+    return [chapter](const auto& filterPeaceTerms, const auto& filterWarTerms) -> Relation {
+        return summarize_chapter(chapter)(filterPeaceTerms, filterWarTerms).relation;
+    };
+};
+
+// The relation of chapter i is the one of chapter number i + 1
+auto number_chapters = [](const vector<Relation>& relations) -> map<int, Relation> {
+    map<int, Relation> chapter_densities;
+    for (size_t i = 0; i < relations.size(); i++) {
+        chapter_densities.emplace_hint(chapter_densities.end(), int(i + 1), relations[i]);
+    }
+    return chapter_densities;
+};
+
+// chapters is a vector of strings or of string_views into the book; it is not copied, so it has to
+// outlive the returned function. The chapter numbers come from the positions of the results, the
+// transform itself shares no state between chapters.
+auto process_all_chapters = [](const auto& chapters) {
+    return [&chapters](const auto& filterPeaceTerms, const auto& filterWarTerms) -> map<int, Relation> {
+        vector<Relation> relations(chapters.size());
+        transform(chapters.begin(), chapters.end(), relations.begin(), [&](const string_view chapter) {
+            return process_chapter(chapter)(filterPeaceTerms, filterWarTerms);
+        });
+        return number_chapters(relations);
+    };
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "TextAnalyzer.h"
+
+#pragma region thread pool
+// A fixed number of workers taking tasks from one queue. Every worker has its own chapter arena,
+// so chapters can be summarized on any of them. onStart runs first on worker i with i, e.g. to pin it
+// to a core before its arena is created.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount, function<void(size_t)> onStart = nullptr) {
+        threadCount = max<size_t>(threadCount, 1);
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, onStart, i]() {
+                if (onStart) {
+                    onStart(i);
+                }
+                work();
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(guard);
+            stopping = true;
+        }
+        available.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(guard);
+            tasks.push_back(std::move(task));
+            pending++;
+        }
+        available.notify_one();
+    }
+
+    // Blocks until every task submitted so far has finished
+    void wait() {
+        unique_lock<mutex> lock(guard);
+        finished.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    void work() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(guard);
+                available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+
+            lock_guard<mutex> lock(guard);
+            if (--pending == 0) {
+                finished.notify_all();
+            }
+        }
+    }
+
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    size_t pending = 0;
+    bool stopping = false;
+    mutex guard;
+    condition_variable available;
+    condition_variable finished;
+};
+
+auto default_thread_count = []() -> size_t {
+    return max<unsigned>(thread::hardware_concurrency(), 1);
+};
+
+// Each worker takes the next chapter index until all are taken; a chapter's summary is stored at
+// its index, so the order of the result does not depend on which worker ran it
+auto summarize_all_chapters_parallel = [](const auto& chapters, ThreadPool& pool) {
+    return [&chapters, &pool](const auto& filterPeaceTerms, const auto& filterWarTerms) -> vector<ChapterSummary> {
+        vector<ChapterSummary> summaries(chapters.size());
+        atomic<size_t> next{0};
+        for (size_t worker = 0; worker < min(pool.size(), chapters.size()); worker++) {
+            pool.submit([&]() {
+                for (size_t i = next++; i < chapters.size(); i = next++) {
+                    summaries[i] = summarize_chapter(chapters[i])(filterPeaceTerms, filterWarTerms);
+                }
+            });
+        }
+        pool.wait();
+        return summaries;
+    };
+};
+
+// Same map as process_all_chapters, chapter i of chapters is chapter number i + 1
+auto process_all_chapters_parallel = [](const auto& chapters, ThreadPool& pool) {
+    return [&chapters, &pool](const auto& filterPeaceTerms, const auto& filterWarTerms) -> map<int, Relation> {
+        auto summaries = summarize_all_chapters_parallel(chapters, pool)(filterPeaceTerms, filterWarTerms);
+        map<int, Relation> chapter_densities;
+        for (size_t i = 0; i < summaries.size(); i++) {
+            chapter_densities.emplace_hint(chapter_densities.end(), int(i + 1), summaries[i].relation);
+        }
+        return chapter_densities;
+    };
+};
+#pragma endregion thread pool
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "TextAnalyzer.h"
+
+// Chapters differ a lot in length, so instead of handing each worker a fixed share of them every
+// worker owns a deque of byte ranges of chapters and idle workers steal from the others. A range
+// above the grain size is split at a space, the second half goes back on the worker's deque where
+// others can steal it, and the partial summaries of the pieces are merged in chapter order.
+#pragma region work stealing
+// Chase-Lev deque of task ids as in "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le et al., 2013): the owner pushes and takes at the bottom, thieves steal from the top.
+class ChaseLevDeque {
+public:
+    static constexpr int64_t empty = -1;
+
+    explicit ChaseLevDeque(size_t capacity = 64) {
+        arrays.push_back(make_unique<Array>(capacity));
+        array.store(arrays.back().get(), memory_order_relaxed);
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    // Owner only
+    void push(const int64_t task) {
+        int64_t b = bottom.load(memory_order_relaxed);
+        int64_t t = top.load(memory_order_acquire);
+        Array* a = array.load(memory_order_relaxed);
+        if (b - t > int64_t(a->capacity) - 1) {
+            a = grow(a, t, b);
+        }
+        a->put(b, task);
+        atomic_thread_fence(memory_order_release);
+        bottom.store(b + 1, memory_order_relaxed);
+    }
+
+    // Owner only
+    int64_t take() {
+        int64_t b = bottom.load(memory_order_relaxed) - 1;
+        Array* a = array.load(memory_order_relaxed);
+        bottom.store(b, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t t = top.load(memory_order_relaxed);
+
+        if (t > b) {
+            bottom.store(b + 1, memory_order_relaxed);
+            return empty;
+        }
+        int64_t task = a->get(b);
+        if (t == b) {
+            // last task, race the thieves for it
+            if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+                task = empty;
+            }
+            bottom.store(b + 1, memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread; empty when there was nothing to steal or another thread was faster
+    int64_t steal() {
+        int64_t t = top.load(memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t b = bottom.load(memory_order_acquire);
+        if (t >= b) {
+            return empty;
+        }
+        Array* a = array.load(memory_order_acquire);
+        int64_t task = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            return empty;
+        }
+        return task;
+    }
+
+private:
+    struct Array {
+        size_t capacity;
+        unique_ptr<atomic<int64_t>[]> slots;
+
+        explicit Array(size_t capacity) : capacity(capacity), slots(new atomic<int64_t>[capacity]) {}
+
+        int64_t get(const int64_t index) const {
+            return slots[size_t(index) & (capacity - 1)].load(memory_order_relaxed);
+        }
+        void put(const int64_t index, const int64_t task) {
+            slots[size_t(index) & (capacity - 1)].store(task, memory_order_relaxed);
+        }
+    };
+
+    // A thief may still read the old array, so it is only freed with the deque
+    Array* grow(Array* old, const int64_t t, const int64_t b) {
+        arrays.push_back(make_unique<Array>(old->capacity * 2));
+        Array* grown = arrays.back().get();
+        for (int64_t i = t; i < b; i++) {
+            grown->put(i, old->get(i));
+        }
+        array.store(grown, memory_order_release);
+        return grown;
+    }
+
+    alignas(cacheLineSize) atomic<int64_t> top{0};
+    alignas(cacheLineSize) atomic<int64_t> bottom{0};
+    atomic<Array*> array;
+    vector<unique_ptr<Array>> arrays;
+};
+
+// Failed attempts to take or steal after which a worker sweeps every deque once and then sleeps
+constexpr size_t stealSpins = 64;
+
+// Where workers that found nothing to take or steal sleep until another range is pushed or the last
+// one is done. notify only costs an increment and a load while nobody sleeps.
+class IdleWorkers {
+public:
+    // Read before looking for work, so that a wait with it returns at once if work came in since
+    uint32_t epoch() const {
+        return published.load(memory_order_acquire);
+    }
+
+    void wait(const uint32_t seen) {
+        sleepers.fetch_add(1, memory_order_seq_cst);
+        // pairs with notify: either notify sees this sleeper, or this load sees the new epoch
+        if (published.load(memory_order_seq_cst) == seen) {
+            published.wait(seen, memory_order_acquire);
+        }
+        sleepers.fetch_sub(1, memory_order_relaxed);
+    }
+
+    void notify() {
+        published.fetch_add(1, memory_order_seq_cst);
+        if (sleepers.load(memory_order_seq_cst) > 0) {
+            published.notify_all();
+        }
+    }
+
+private:
+    alignas(cacheLineSize) atomic<uint32_t> published{0};
+    atomic<size_t> sleepers{0};
+};
+
+struct RangeTask {
+    uint32_t chapter;
+    uint32_t begin;
+    uint32_t end;
+};
+
+struct WorkerStats {
+    size_t ranges = 0;
+    size_t splits = 0;
+    size_t steals = 0;
+    size_t failedSteals = 0;
+    double busyMilliseconds = 0;
+    double totalMilliseconds = 0;
+
+    double utilization() const {
+        return totalMilliseconds > 0 ? busyMilliseconds / totalMilliseconds : 0;
+    }
+};
+
+struct StealingRun {
+    vector<ChapterSummary> summaries;
+    vector<WorkerStats> workers;
+};
+
+// Splits at the first space from the middle on, or the last one before it; nullopt if there is none
+auto split_point = [](const string_view chapter, const RangeTask& task) -> optional<uint32_t> {
+    const string_view range = chapter.substr(task.begin, task.end - task.begin);
+    size_t split = range.find(' ', range.size() / 2);
+    if (split == string_view::npos) {
+        split = range.rfind(' ', range.size() / 2);
+    }
+    if (split == string_view::npos) {
+        return nullopt;
+    }
+    return task.begin + uint32_t(split);
+};
+
+// Ranges longer than grainSize bytes are split; by default a range is about a 32nd of a worker's share
+auto default_grain_size = [](const size_t totalBytes, const size_t threadCount) -> size_t {
+    return max<size_t>(4096, totalBytes / (threadCount * 32));
+};
+
+// Like ThreadPool, onStart runs first on worker i with i, e.g. to pin it to a core; every worker has a
+// thread of its own then, so the calling thread is left where it is
+auto summarize_all_chapters_stealing = [](const auto& chapters, const size_t threadCount, const size_t grainSize,
+                                          function<void(size_t)> onStart = nullptr) {
+    return [&chapters, threadCount, grainSize, onStart](const auto& filterPeaceTerms, const auto& filterWarTerms) -> StealingRun {
+        struct Piece {
+            uint32_t chapter;
+            uint32_t begin;
+            ChapterPartial partial;
+        };
+
+        const size_t workerCount = max<size_t>(threadCount, 1);
+        size_t totalBytes = 0;
+        for (const string_view chapter : chapters) {
+            totalBytes += chapter.size();
+        }
+
+        // every split adds one task and halves a range of more than grainSize bytes; ranges of texts
+        // with hardly any spaces stop splitting once the tasks are used up
+        vector<RangeTask> tasks(chapters.size() * 2 + 2 * totalBytes / max<size_t>(grainSize, 1) + 1);
+        atomic<size_t> taskCount{chapters.size()};
+        atomic<size_t> unfinished{chapters.size()};
+        vector<unique_ptr<ChaseLevDeque>> deques;
+        for (size_t worker = 0; worker < workerCount; worker++) {
+            deques.push_back(make_unique<ChaseLevDeque>());
+        }
+        for (size_t i = 0; i < chapters.size(); i++) {
+            tasks[i] = RangeTask{uint32_t(i), 0, uint32_t(string_view(chapters[i]).size())};
+            deques[i % workerCount]->push(int64_t(i));
+        }
+
+        vector<vector<Piece>> pieces(workerCount);
+        vector<WorkerStats> stats(workerCount);
+        IdleWorkers idle;
+        auto work = [&](const size_t self) {
+            WorkerStats& mine = stats[self];
+            mt19937 victims{uint32_t(self)};
+            auto started = chrono::steady_clock::now();
+            size_t misses = 0;
+            while (unfinished.load(memory_order_acquire) > 0) {
+                const uint32_t seen = idle.epoch();
+                int64_t taken = deques[self]->take();
+                if (taken == ChaseLevDeque::empty && workerCount > 1) {
+                    size_t victim = (self + 1 + victims() % (workerCount - 1)) % workerCount;
+                    taken = deques[victim]->steal();
+                    (taken == ChaseLevDeque::empty ? mine.failedSteals : mine.steals)++;
+                }
+                if (taken == ChaseLevDeque::empty && ++misses >= stealSpins) {
+                    for (size_t victim = (self + 1) % workerCount; victim != self && taken == ChaseLevDeque::empty;
+                         victim = (victim + 1) % workerCount) {
+                        taken = deques[victim]->steal();
+                    }
+                    if (taken == ChaseLevDeque::empty) {
+                        // only the owner pushes onto a deque, and it is awake while its deque is not
+                        // empty, so a range left anywhere is taken without this worker
+                        misses = 0;
+                        if (unfinished.load(memory_order_acquire) > 0) {
+                            idle.wait(seen);
+                        }
+                        continue;
+                    }
+                    mine.steals++;
+                }
+                if (taken == ChaseLevDeque::empty) {
+                    this_thread::yield();
+                    continue;
+                }
+                misses = 0;
+
+                auto busy = chrono::steady_clock::now();
+                RangeTask task = tasks[size_t(taken)];
+                const string_view chapter = chapters[task.chapter];
+                while (task.end - task.begin > grainSize) {
+                    auto split = split_point(chapter, task);
+                    if (!split.has_value()) {
+                        break;
+                    }
+                    size_t second = taskCount++;
+                    if (second >= tasks.size()) {
+                        taskCount--;
+                        break;
+                    }
+                    tasks[second] = RangeTask{task.chapter, split.value() + 1, task.end};
+                    unfinished++;
+                    deques[self]->push(int64_t(second));
+                    idle.notify();
+                    task.end = split.value();
+                    mine.splits++;
+                }
+
+                auto partial = partial_summary(chapter.substr(task.begin, task.end - task.begin))(filterPeaceTerms, filterWarTerms);
+                pieces[self].push_back(Piece{task.chapter, task.begin, partial});
+                mine.ranges++;
+                mine.busyMilliseconds += chrono::duration<double, milli>(chrono::steady_clock::now() - busy).count();
+                if (unfinished.fetch_sub(1, memory_order_acq_rel) == 1) {
+                    idle.notify();
+                }
+            }
+            mine.totalMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+        };
+
+        vector<thread> workers;
+        for (size_t worker = onStart ? 0 : 1; worker < workerCount; worker++) {
+            workers.emplace_back([&work, &onStart, worker]() {
+                if (onStart) {
+                    onStart(worker);
+                }
+                work(worker);
+            });
+        }
+        if (!onStart) {
+            work(0);
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+
+        vector<Piece> all;
+        for (auto& workerPieces : pieces) {
+            all.insert(all.end(), workerPieces.begin(), workerPieces.end());
+        }
+        sort(all.begin(), all.end(), [](const Piece& a, const Piece& b) {
+            return a.chapter != b.chapter ? a.chapter < b.chapter : a.begin < b.begin;
+        });
+
+        StealingRun run{{}, stats};
+        auto piece = all.begin();
+        for (uint32_t chapter = 0; chapter < chapters.size(); chapter++) {
+            PartialReduction reduction;
+            for (; piece != all.end() && piece->chapter == chapter; ++piece) {
+                reduction.add(piece->partial);
+            }
+            run.summaries.push_back(summarize_partial(reduction.result()));
+        }
+        return run;
+    };
+};
+
+auto print_worker_stats = [](ostream& out, const vector<WorkerStats>& workers) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        const WorkerStats& worker = workers[i];
+        out << "Worker " << i << ": " << int(worker.utilization() * 100 + 0.5) << "% busy, " << worker.ranges << " ranges, "
+            << worker.splits << " splits, " << worker.steals << " steals (" << worker.failedSteals << " failed)" << endl;
+    }
+};
+#pragma endregion work stealing
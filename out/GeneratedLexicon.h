@@ -0,0 +1,328 @@
+// Generated by LexiconCompiler --cpp, do not edit
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the generated matcher compares little-endian loads"
+#endif
+
+inline uint64_t generated_load64(const char* s) { uint64_t v; memcpy(&v, s, 8); return v; }
+inline uint32_t generated_load32(const char* s) { uint32_t v; memcpy(&v, s, 4); return v; }
+inline uint16_t generated_load16(const char* s) { uint16_t v; memcpy(&v, s, 2); return v; }
+inline uint8_t generated_load8(const char* s) { return uint8_t(*s); }
+
+constexpr size_t generated_term_count = 109;
+
+inline uint8_t generated_category_mask(const char* s, size_t n) {
+    switch(n){
+    case 3:
+        switch(s[0]){
+        case 'g':
+            if(generated_load16(s + 1) == 0x6e75u) return 1;
+            break;
+        case 's':
+            if(generated_load16(s + 1) == 0x6461u) return 1;
+            break;
+        case 'w':
+            if(generated_load16(s + 1) == 0x7261u) return 1;
+            break;
+        }
+        break;
+    case 4:
+        switch(s[0]){
+        case 'c':
+            if(generated_load16(s + 1) == 0x6c61u && generated_load8(s + 3) == 0x6du) return 2;
+            break;
+        case 'd':
+            if(generated_load16(s + 1) == 0x6165u && generated_load8(s + 3) == 0x64u) return 1;
+            break;
+        case 'f':
+            if(generated_load16(s + 1) == 0x6f6fu && generated_load8(s + 3) == 0x64u) return 2;
+            if(generated_load16(s + 1) == 0x6165u && generated_load8(s + 3) == 0x72u) return 1;
+            if(generated_load16(s + 1) == 0x7565u && generated_load8(s + 3) == 0x64u) return 1;
+            break;
+        case 'h':
+            if(generated_load16(s + 1) == 0x6d6fu && generated_load8(s + 3) == 0x65u) return 2;
+            if(generated_load16(s + 1) == 0x7461u && generated_load8(s + 3) == 0x65u) return 1;
+            break;
+        case 'k':
+            if(generated_load16(s + 1) == 0x6c69u && generated_load8(s + 3) == 0x6cu) return 1;
+            break;
+        case 'l':
+            if(generated_load16(s + 1) == 0x766fu && generated_load8(s + 3) == 0x65u) return 2;
+            if(generated_load16(s + 1) == 0x736fu && generated_load8(s + 3) == 0x73u) return 1;
+            break;
+        case 'p':
+            if(generated_load16(s + 1) == 0x6961u && generated_load8(s + 3) == 0x6eu) return 1;
+            break;
+        case 't':
+            if(generated_load16(s + 1) == 0x6e61u && generated_load8(s + 3) == 0x6bu) return 1;
+            break;
+        }
+        break;
+    case 5:
+        switch(s[0]){
+        case 'a':
+            if(generated_load32(s + 1) == 0x7974696du) return 2;
+            if(generated_load32(s + 1) == 0x64656d72u) return 1;
+            break;
+        case 'b':
+            if(generated_load32(s + 1) == 0x736b6f6fu) return 2;
+            break;
+        case 'd':
+            if(generated_load32(s + 1) == 0x68746165u) return 1;
+            break;
+        case 'e':
+            if(generated_load32(s + 1) == 0x796d656eu) return 1;
+            break;
+        case 'f':
+            if(generated_load32(s + 1) == 0x72756f6cu) return 2;
+            if(generated_load32(s + 1) == 0x74697572u) return 2;
+            if(generated_load32(s + 1) == 0x74686769u) return 1;
+            break;
+        case 'g':
+            if(generated_load32(s + 1) == 0x6e696172u) return 2;
+            if(generated_load32(s + 1) == 0x6d6f6f6cu) return 1;
+            if(generated_load32(s + 1) == 0x66656972u) return 1;
+            break;
+        case 'h':
+            if(generated_load32(s + 1) == 0x6573756fu) return 2;
+            break;
+        case 'm':
+            if(generated_load32(s + 1) == 0x63697375u) return 2;
+            if(generated_load32(s + 1) == 0x6e72756fu) return 1;
+            break;
+        case 'p':
+            if(generated_load32(s + 1) == 0x79747261u) return 2;
+            if(generated_load32(s + 1) == 0x65636165u) return 2;
+            if(generated_load32(s + 1) == 0x656e616cu) return 1;
+            break;
+        case 'q':
+            if(generated_load32(s + 1) == 0x74656975u) return 2;
+            break;
+        case 's':
+            if(generated_load32(s + 1) == 0x656c696du) return 2;
+            if(generated_load32(s + 1) == 0x74656577u) return 2;
+            if(generated_load32(s + 1) == 0x746f6f68u) return 1;
+            if(generated_load32(s + 1) == 0x656b6f6du) return 1;
+            if(generated_load32(s + 1) == 0x64726f77u) return 1;
+            break;
+        case 't':
+            if(generated_load32(s + 1) == 0x65637572u) return 2;
+            break;
+        case 'u':
+            if(generated_load32(s + 1) == 0x6e6f696eu) return 2;
+            break;
+        }
+        break;
+    case 6:
+        switch(s[0]){
+        case 'a':
+            if(generated_load32(s + 1) == 0x69617266u && generated_load8(s + 5) == 0x64u) return 1;
+            break;
+        case 'b':
+            if(generated_load32(s + 1) == 0x65747475u && generated_load8(s + 5) == 0x72u) return 2;
+            if(generated_load32(s + 1) == 0x6c747461u && generated_load8(s + 5) == 0x65u) return 1;
+            break;
+        case 'c':
+            if(generated_load32(s + 1) == 0x6e697972u && generated_load8(s + 5) == 0x67u) return 1;
+            break;
+        case 'f':
+            if(generated_load32(s + 1) == 0x646c6569u && generated_load8(s + 5) == 0x73u) return 2;
+            if(generated_load32(s + 1) == 0x65776f6cu && generated_load8(s + 5) == 0x72u) return 2;
+            if(generated_load32(s + 1) == 0x6e696d61u && generated_load8(s + 5) == 0x65u) return 1;
+            break;
+        case 'm':
+            if(generated_load32(s + 1) == 0x72657369u && generated_load8(s + 5) == 0x79u) return 1;
+            break;
+        case 'p':
+            if(generated_load32(s + 1) == 0x746e656cu && generated_load8(s + 5) == 0x79u) return 2;
+            break;
+        case 's':
+            if(generated_load32(s + 1) == 0x65707075u && generated_load8(s + 5) == 0x72u) return 2;
+            if(generated_load32(s + 1) == 0x65666675u && generated_load8(s + 5) == 0x72u) return 1;
+            break;
+        case 't':
+            if(generated_load32(s + 1) == 0x74616572u && generated_load8(s + 5) == 0x79u) return 2;
+            if(generated_load32(s + 1) == 0x636e6572u && generated_load8(s + 5) == 0x68u) return 1;
+            break;
+        case 'w':
+            if(generated_load32(s + 1) == 0x746c6165u && generated_load8(s + 5) == 0x68u) return 2;
+            if(generated_load32(s + 1) == 0x6f706165u && generated_load8(s + 5) == 0x6eu) return 1;
+            break;
+        }
+        break;
+    case 7:
+        switch(s[0]){
+        case 'a':
+            if(generated_load32(s + 1) == 0x6975676eu && generated_load16(s + 5) == 0x6873u) return 1;
+            break;
+        case 'c':
+            if(generated_load32(s + 1) == 0x6f636e6fu && generated_load16(s + 5) == 0x6472u) return 2;
+            if(generated_load32(s + 1) == 0x75747061u && generated_load16(s + 5) == 0x6572u) return 1;
+            if(generated_load32(s + 1) == 0x61737572u && generated_load16(s + 5) == 0x6564u) return 1;
+            break;
+        case 'd':
+            if(generated_load32(s + 1) == 0x61707365u && generated_load16(s + 5) == 0x7269u) return 1;
+            break;
+        case 'e':
+            if(generated_load32(s + 1) == 0x696d656eu && generated_load16(s + 5) == 0x7365u) return 1;
+            break;
+        case 'f':
+            if(generated_load32(s + 1) == 0x64656572u && generated_load16(s + 5) == 0x6d6fu) return 2;
+            break;
+        case 'g':
+            if(generated_load32(s + 1) == 0x72656e65u && generated_load16(s + 5) == 0x6c61u) return 1;
+            if(generated_load32(s + 1) == 0x616e6572u && generated_load16(s + 5) == 0x6564u) return 1;
+            break;
+        case 'h':
+            if(generated_load32(s + 1) == 0x6f6d7261u && generated_load16(s + 5) == 0x796eu) return 2;
+            if(generated_load32(s + 1) == 0x65767261u && generated_load16(s + 5) == 0x7473u) return 2;
+            break;
+        case 'l':
+            if(generated_load32(s + 1) == 0x72656269u && generated_load16(s + 5) == 0x7974u) return 2;
+            break;
+        case 'm':
+            if(generated_load32(s + 1) == 0x69747261u && generated_load16(s + 5) == 0x6c61u) return 1;
+            break;
+        case 'r':
+            if(generated_load32(s + 1) == 0x69707365u && generated_load16(s + 5) == 0x6574u) return 2;
+            if(generated_load32(s + 1) == 0x6c617669u && generated_load16(s + 5) == 0x7972u) return 1;
+            break;
+        case 's':
+            if(generated_load32(s + 1) == 0x69646c6fu && generated_load16(s + 5) == 0x7265u) return 1;
+            break;
+        case 'u':
+            if(generated_load32(s + 1) == 0x6f66696eu && generated_load16(s + 5) == 0x6d72u) return 1;
+            break;
+        case 'w':
+            if(generated_load32(s + 1) == 0x696c6961u && generated_load16(s + 5) == 0x676eu) return 1;
+            break;
+        }
+        break;
+    case 8:
+        switch(s[0]){
+        case 'b':
+            if(generated_load32(s + 1) == 0x77627261u && generated_load16(s + 5) == 0x7269u && generated_load8(s + 7) == 0x65u) return 1;
+            break;
+        case 'c':
+            if(generated_load32(s + 1) == 0x72746e6fu && generated_load16(s + 5) == 0x6361u && generated_load8(s + 7) == 0x74u) return 2;
+            if(generated_load32(s + 1) == 0x6c666e6fu && generated_load16(s + 5) == 0x6369u && generated_load8(s + 7) == 0x74u) return 1;
+            break;
+        case 'd':
+            if(generated_load32(s + 1) == 0x6f6c7069u && generated_load16(s + 5) == 0x616du && generated_load8(s + 7) == 0x74u) return 2;
+            break;
+        case 'p':
+            if(generated_load32(s + 1) == 0x74696c6fu && generated_load16(s + 5) == 0x6369u && generated_load8(s + 7) == 0x73u) return 1;
+            break;
+        case 's':
+            if(generated_load32(s + 1) == 0x6e657265u && generated_load16(s + 5) == 0x7469u && generated_load8(s + 7) == 0x79u) return 2;
+            if(generated_load32(s + 1) == 0x67757274u && generated_load16(s + 5) == 0x6c67u && generated_load8(s + 7) == 0x65u) return 1;
+            break;
+        }
+        break;
+    case 9:
+        switch(s[0]){
+        case 'a':
+            if(generated_load64(s + 1) == 0x65636e61646e7562ull) return 2;
+            if(generated_load64(s + 1) == 0x746e656d65657267ull) return 2;
+            break;
+        case 'b':
+            if(generated_load64(s + 1) == 0x747361666b616572ull) return 2;
+            break;
+        case 'c':
+            if(generated_load64(s + 1) == 0x6572696665736165ull) return 2;
+            if(generated_load64(s + 1) == 0x73756f657472756full) return 2;
+            if(generated_load64(s + 1) == 0x7265646e616d6d6full) return 1;
+            break;
+        case 'd':
+            if(generated_load64(s + 1) == 0x7963616d6f6c7069ull) return 2;
+            break;
+        case 'e':
+            if(generated_load64(s + 1) == 0x6574616369646172ull) return 1;
+            if(generated_load64(s + 1) == 0x6e6f69736f6c7078ull) return 1;
+            break;
+        case 'g':
+            if(generated_load64(s + 1) == 0x726564776f706e75ull) return 1;
+            break;
+        case 'h':
+            if(generated_load64(s + 1) == 0x7974696c6974736full) return 1;
+            break;
+        case 'p':
+            if(generated_load64(s + 1) == 0x6e6f697375666f72ull) return 2;
+            break;
+        case 's':
+            if(generated_load64(s + 1) == 0x7373656e6c6c6974ull) return 2;
+            break;
+        case 'v':
+            if(generated_load64(s + 1) == 0x656c626174656765ull) return 2;
+            break;
+        case 'w':
+            if(generated_load64(s + 1) == 0x6c75667265646e6full) return 2;
+            break;
+        }
+        break;
+    case 10:
+        switch(s[0]){
+        case 'd':
+            if(generated_load64(s + 1) == 0x6f69737365727065ull && generated_load8(s + 9) == 0x6eu) return 1;
+            if(generated_load64(s + 1) == 0x6f6974616c6f7365ull && generated_load8(s + 9) == 0x6eu) return 1;
+            break;
+        case 'e':
+            if(generated_load64(s + 1) == 0x6e656d796f6c706dull && generated_load8(s + 9) == 0x74u) return 2;
+            break;
+        case 'q':
+            if(generated_load64(s + 1) == 0x6e69746e61726175ull && generated_load8(s + 9) == 0x65u) return 1;
+            break;
+        }
+        break;
+    case 11:
+        switch(s[0]){
+        case 'c':
+            if(generated_load64(s + 1) == 0x6e65727275636e6full && generated_load16(s + 9) == 0x6563u) return 2;
+            break;
+        case 'd':
+            if(generated_load64(s + 1) == 0x6974757469747365ull && generated_load16(s + 9) == 0x6e6fu) return 1;
+            if(generated_load64(s + 1) == 0x6974637572747365ull && generated_load16(s + 9) == 0x6e6fu) return 1;
+            break;
+        case 'n':
+            if(generated_load64(s + 1) == 0x69746169746f6765ull && generated_load16(s + 9) == 0x6e6fu) return 2;
+            break;
+        case 't':
+            if(generated_load64(s + 1) == 0x696c6975716e6172ull && generated_load16(s + 9) == 0x7974u) return 2;
+            break;
+        }
+        break;
+    case 12:
+        switch(s[0]){
+        case 'd':
+            if(generated_load64(s + 1) == 0x6d65657267617369ull && generated_load16(s + 9) == 0x6e65u && generated_load8(s + 11) == 0x74u) return 1;
+            break;
+        case 'h':
+            if(generated_load64(s + 1) == 0x6e7373656c65706full && generated_load16(s + 9) == 0x7365u && generated_load8(s + 11) == 0x73u) return 1;
+            break;
+        }
+        break;
+    case 13:
+        switch(s[0]){
+        case 'c':
+            if(generated_load64(s + 1) == 0x61746e6f72666e6full && generated_load32(s + 9) == 0x6e6f6974u) return 1;
+            break;
+        case 'u':
+            if(generated_load64(s + 1) == 0x6e6174737265646eull && generated_load32(s + 9) == 0x676e6964u) return 2;
+            break;
+        }
+        break;
+    case 14:
+        switch(s[0]){
+        case 'r':
+            if(generated_load64(s + 1) == 0x696c69636e6f6365ull && generated_load32(s + 9) == 0x6f697461u && generated_load8(s + 13) == 0x6eu) return 2;
+            break;
+        }
+        break;
+    }
+    return 0;
+}
@@ -10,6 +10,7 @@ fi
 
 echo "Running the C++ tests..."
 ./out/Tests
+./out/AllocationTests
 
 echo "Running the C++ program..."
 ./out/TextAnalyzer
\ No newline at end of file